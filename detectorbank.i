@@ -38,6 +38,32 @@ import_array();
 %ignore DetectorBank::GetZ_params;
 %ignore DetectorBank::AbsZ_params;
 %ignore NoteDetector::Analyse_params;
+// std::function isn't wrapped; Python can poll getNormalisationProgress()
+%ignore DetectorBank::setNormalisationCallback;
+// process() and flush() are wrapped with the shapes of their arrays below
+%ignore DetectorBank::process(const inputSample_t*, const std::size_t, discriminator_t*);
+%ignore DetectorBank::flush(discriminator_t*);
+// Interleaved and integer audio is passed to these by setInputBuffer()
+// and the constructor, which take it as a NumPy array of any shape
+%ignore DetectorBank::DetectorBank(const parameter_t, const std::int16_t*,
+                                   const std::size_t, const std::size_t, std::size_t,
+                                   const parameter_t*, parameter_t*, const std::size_t,
+                                   Features, parameter_t, const parameter_t);
+%ignore DetectorBank::DetectorBank(const parameter_t, const std::int32_t*,
+                                   const std::size_t, const std::size_t, const unsigned,
+                                   std::size_t, const parameter_t*, parameter_t*,
+                                   const std::size_t, Features, parameter_t,
+                                   const parameter_t);
+%rename(_setInterleavedInput) DetectorBank::setInputBuffer(const inputSample_t*,
+                                                           const std::size_t,
+                                                           const std::size_t);
+%rename(_setInt16Input) DetectorBank::setInputBuffer(const std::int16_t*,
+                                                     const std::size_t,
+                                                     const std::size_t);
+%rename(_setInt32Input) DetectorBank::setInputBuffer(const std::int32_t*,
+                                                     const std::size_t,
+                                                     const std::size_t,
+                                                     const unsigned);
 
 namespace std {
   %template(liststr) list<string>;
@@ -89,6 +115,28 @@ namespace std {
 
             return buf
 
+       def _isPCMInput(self, buf):
+            # Whether the audio is integer or has more than one channel,
+            # so is converted to mono float32 in C++ (see _setPCMInput)
+            from numpy import dtype
+            pcm = buf.ndim == 2 and buf.dtype is dtype('float32') or \
+                  buf.ndim <= 2 and buf.dtype in (dtype('int16'), dtype('int32'))
+            del dtype
+            return pcm
+
+       def _setPCMInput(self, buf):
+            # Scale and downmix integer or multichannel audio in a single
+            # pass, without the temporary arrays made by _checkBufferType
+            from numpy import dtype
+            frames = buf.reshape(len(buf), -1)
+            if buf.dtype is dtype('int16'):
+                self._setInt16Input(frames)
+            elif buf.dtype is dtype('int32'):
+                self._setInt32Input(frames, 32)
+            else:
+                self._setInterleavedInput(frames)
+            del dtype
+
        def _checkNumericArgs(self, args):
            # typecheck/cast the sample rate, num threads, damping and gain
            # as there are some weird errors where NumPy types cause errors
@@ -120,24 +168,44 @@ namespace std {
     # right type etc.
 
     args = list(args)
-
-    # The c++ code only deals with mono audio but we'd like to deal with
-    # more channels on demand
-    # Fortunately, the input buffer is the second argument in all forms
-    # of the constructor, so no need to check len(args) here.
-    # This also makes sure the data type is float32
-    b = self._checkBufferType(args[1])
-
-    if b is not args[1]:
-        args[1] = b
-
-    # Keep a local copy so it doesn't get garbage-collected
-    self._ibuf = args[1]
+    pcm = None
+
+    # A bank reading its input from a file is given the file's path and
+    # the number of threads, followed by the detector characteristics
+    if isinstance(args[0], str) and isinstance(args[1], int):
+        if len(args) > 2:
+            from numpy import transpose
+            args[2] = transpose(self._checkDetCharType(args[2]))
+            # Keep a local copy
+            self._transposed_array = args[2]
+            del transpose
+
+    else:
+        # Integer or multichannel audio is given to the bank once it has
+        # been made with an empty buffer, and converted in C++
+        if self._isPCMInput(args[1]):
+            from numpy import zeros, float32
+            pcm = args[1]
+            args[1] = zeros(0, dtype=float32)
+            del zeros, float32
+
+        # The c++ code only deals with mono audio but we'd like to deal with
+        # more channels on demand
+        # Fortunately, the input buffer is the second argument in all other
+        # forms of the constructor, so no need to check len(args) here.
+        # This also makes sure the data type is float32
+        b = self._checkBufferType(args[1])
+
+        if b is not args[1]:
+            args[1] = b
+
+        # Keep a local copy so it doesn't get garbage-collected
+        self._ibuf = args[1]
 
     # If the DetectorBank has been given parameters to construct
     # a new bank (as opposed to loading a saved profile), check that
     # all the args are of the right type
-    if len(args) > 2:
+    if len(args) > 2 and not isinstance(args[0], str):
 
         from numpy import transpose
 
@@ -159,7 +227,15 @@ namespace std {
 
         del transpose
 %}
+%pythonappend DetectorBank::DetectorBank %{
+    if pcm is not None:
+        self._setPCMInput(pcm)
+%}
 %pythonprepend DetectorBank::setInputBuffer %{
+    if self._isPCMInput(inputBuffer):
+        self._ibuf = None
+        return self._setPCMInput(inputBuffer)
+
     inputBuffer = self._checkBufferType(inputBuffer)
 
     # Keep a local copy so it doesn't get garbage-collected
@@ -228,6 +304,15 @@ namespace std {
 
 %apply (float* IN_ARRAY1, int DIM1) {(const inputSample_t* inputBuffer,
                                       const std::size_t inputBufferSize)};
+%apply (float* IN_ARRAY2, int DIM1, int DIM2) {(const inputSample_t* inputBuffer,
+                                                const std::size_t numFrames,
+                                                const std::size_t numChannels)};
+%apply (short* IN_ARRAY2, int DIM1, int DIM2) {(const std::int16_t* inputBuffer,
+                                                const std::size_t numFrames,
+                                                const std::size_t numChannels)};
+%apply (int* IN_ARRAY2, int DIM1, int DIM2) {(const std::int32_t* inputBuffer,
+                                              const std::size_t numFrames,
+                                              const std::size_t numChannels)};
 // apply the typemap we created, which takes a pointer and two sizes and returns
 // two pointers and one size
 %apply (parameter_t* IN_ARRAY2, DIM_TYPE DIM1, DIM_TYPE DIM2) {(const parameter_t* freqs,
@@ -236,11 +321,21 @@ namespace std {
 %apply (std::complex<double>* INPLACE_ARRAY2, int DIM1, int DIM2) {(discriminator_t* frames,
                                                                     std::size_t chans,
                                                                     std::size_t numFrames)};
+%apply (std::complex<float>* INPLACE_ARRAY2, int DIM1, int DIM2) {(discriminatorf_t* frames,
+                                                                   std::size_t chans,
+                                                                   std::size_t numFrames)};
 %apply (double* INPLACE_ARRAY2, int DIM1, int DIM2) {(result_t* absFrames,
                                                       std::size_t absChans,
                                                       std::size_t absNumFrames)};
+%apply (float* INPLACE_ARRAY2, int DIM1, int DIM2) {(resultf_t* absFrames,
+                                                     std::size_t absChans,
+                                                     std::size_t absNumFrames)};
 %apply (double* INPLACE_ARRAY1, int DIM1) {(result_t* samples,
                                             std::size_t numSamples)};
+%apply (double* INPLACE_ARRAY1, int DIM1) {(result_t* maxima,
+                                            std::size_t maxChans)};
+%apply (float* INPLACE_ARRAY1, int DIM1) {(resultf_t* maxima,
+                                           std::size_t maxChans)};
 
 // A detector cache is a specialisation of a sliding buffer,
 // but there's no need to generate python bindings to the
@@ -364,6 +459,121 @@ namespace std {
         return $self->absZ(absFrames, absChans, absNumFrames, frames, maxThreads);
 
     }
+
+    inline resultf_t DetectorBank::absZ(resultf_t* absFrames,
+                                        std::size_t absChans,
+                                        std::size_t absNumFrames,
+                                        discriminatorf_t* frames,
+                                        std::size_t chans,
+                                        std::size_t numFrames,
+                                        std::size_t maxThreads = 0
+                     ) const {
+        if (absChans != chans || absNumFrames != numFrames)
+            throw std::runtime_error(
+                "DetectorBank::absZ input and output arrays must be the same shape"
+            );
+
+        return $self->absZ(absFrames, absChans, absNumFrames, frames, maxThreads);
+
+    }
+
+    /**
+     * As for absZ, Python passes the array of maxima with its size,
+     * which must match the height of the output array.
+     */
+    inline int DetectorBank::getAbsZ(result_t* absFrames,
+                                     std::size_t absChans,
+                                     std::size_t absNumFrames,
+                                     const std::size_t startChan,
+                                     result_t* maxima,
+                                     std::size_t maxChans) {
+        if (maxChans != absChans)
+            throw std::runtime_error(
+                "DetectorBank::getAbsZ maxima must have one element per channel"
+            );
+
+        return $self->getAbsZ(absFrames, absChans, absNumFrames, startChan, maxima);
+    }
+
+    inline int DetectorBank::getAbsZ(resultf_t* absFrames,
+                                     std::size_t absChans,
+                                     std::size_t absNumFrames,
+                                     const std::size_t startChan,
+                                     resultf_t* maxima,
+                                     std::size_t maxChans) {
+        if (maxChans != absChans)
+            throw std::runtime_error(
+                "DetectorBank::getAbsZ maxima must have one element per channel"
+            );
+
+        return $self->getAbsZ(absFrames, absChans, absNumFrames, startChan, maxima);
+    }
+
+    inline int DetectorBank::getPooledZ(result_t* absFrames,
+                                        std::size_t absChans,
+                                        std::size_t absNumFrames,
+                                        const std::size_t hop,
+                                        const DetectorBank::Pooling pooling,
+                                        const std::size_t startChan,
+                                        result_t* maxima,
+                                        std::size_t maxChans) {
+        if (maxChans != absChans)
+            throw std::runtime_error(
+                "DetectorBank::getPooledZ maxima must have one element per channel"
+            );
+
+        return $self->getPooledZ(absFrames, absChans, absNumFrames, hop, pooling,
+                                 startChan, maxima);
+    }
+
+    inline int DetectorBank::getPooledZ(resultf_t* absFrames,
+                                        std::size_t absChans,
+                                        std::size_t absNumFrames,
+                                        const std::size_t hop,
+                                        const DetectorBank::Pooling pooling,
+                                        const std::size_t startChan,
+                                        resultf_t* maxima,
+                                        std::size_t maxChans) {
+        if (maxChans != absChans)
+            throw std::runtime_error(
+                "DetectorBank::getPooledZ maxima must have one element per channel"
+            );
+
+        return $self->getPooledZ(absFrames, absChans, absNumFrames, hop, pooling,
+                                 startChan, maxima);
+    }
+
+    /**
+     * Python passes the output array of process() and flush() with its
+     * shape, which must have a row for each channel and room for the
+     * frames to be written.
+     */
+    inline int DetectorBank::process(const inputSample_t* inputBuffer,
+                                     const std::size_t inputBufferSize,
+                                     discriminator_t* frames,
+                                     std::size_t chans,
+                                     std::size_t numFrames) {
+        if (chans != $self->getChans() ||
+            numFrames != $self->getBlockFrames(inputBufferSize))
+            throw std::runtime_error(
+                "DetectorBank::process output array must have a row per channel "
+                "and getBlockFrames() columns"
+            );
+
+        return $self->process(inputBuffer, inputBufferSize, frames);
+    }
+
+    inline int DetectorBank::flush(discriminator_t* frames,
+                                   std::size_t chans,
+                                   std::size_t numFrames) {
+        if (chans != $self->getChans() || numFrames != $self->getLatency())
+            throw std::runtime_error(
+                "DetectorBank::flush output array must have a row per channel "
+                "and a column per frame of latency"
+            );
+
+        return $self->flush(frames);
+    }
 }
 
 %apply (float* IN_ARRAY1, int DIM1) {(const inputSample_t* inputSignal,
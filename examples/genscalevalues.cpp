@@ -0,0 +1,118 @@
+/*
+ * Generate the scale frequencies and factors in src/scale_values.inc
+ * for one numerical method, frequency normalisation and sample rate.
+ *
+ * For each of 150 frequencies spaced evenly from 5Hz to 4.2kHz, a
+ * minimum-bandwidth, amplitude-unnormalised detector is driven for 60
+ * seconds by a sine tone at its characteristic frequency with the
+ * default damping and gain. The scale factor is the output at which
+ * |z| is greatest. For search-normalised detectors the adjusted
+ * frequency is recorded and used for the tone.
+ *
+ * Compile with
+ *   g++ -std=gnu++17 -O2 -I../src $(pkg-config --cflags fftw3f) genscalevalues.cpp -ldetectorbank -pthread
+ * and run as
+ *   ./a.out {rk4|cd|exact|si} {un|sn} {44100|48000}
+ */
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <complex>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "detectors.h"
+
+namespace {
+    // Shortest representation which reads back as the same value,
+    // in the form used in scale_values.inc
+    std::string repr(const parameter_t v)
+    {
+        char buf[32];
+        const auto end { std::to_chars(buf, buf+sizeof(buf), v).ptr };
+        std::string s(buf, end);
+        if (s.find_first_of(".e") == std::string::npos)
+            s += ".0";
+        return s;
+    }
+}
+
+template <class Detector>
+void measure(const bool nrml, const parameter_t sr,
+             parameter_t* freqs, discriminator_t* factors,
+             const std::size_t numFreqs)
+{
+    constexpr parameter_t fLow {5.}, fHigh {4200.};
+    constexpr parameter_t mu {0.}, d {0.0001}, gain {25.};
+    const std::size_t samples { static_cast<std::size_t>(60*sr) };
+
+    std::unique_ptr<inputSample_t[]> tone(new inputSample_t[samples]);
+    std::unique_ptr<discriminator_t[]> z(new discriminator_t[samples]);
+
+    for (std::size_t n{0}; n < numFreqs; n++) {
+        const parameter_t f { fLow + n*(fHigh-fLow)/(numFreqs-1) };
+
+        // The detectors are used directly rather than through a
+        // DetectorBank so that they are not frequency shifted.
+        Detector det(f, mu, d, sr, 0., gain);
+        if (nrml)
+            det.searchNormalize(0.92, 1.08, 3.0, gain);
+        freqs[n] = det.getW()/(2*M_PI);
+
+        det.generateTone(&tone[0], samples, freqs[n]);
+        for (std::size_t i{0}; i < samples; i++)
+            tone[i] *= gain;
+        det.processAudio(&z[0], &tone[0], samples);
+
+        std::size_t where {0};
+        for (std::size_t i{0}; i < samples; i++)
+            if (std::abs(z[i]) > std::abs(z[where]))
+                where = i;
+        factors[n] = z[where];
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " {rk4|cd|exact|si} {un|sn} {44100|48000}\n";
+        return 1;
+    }
+
+    const bool nrml { !std::strcmp(argv[2], "sn") };
+    const parameter_t sr { std::stod(argv[3]) };
+
+    constexpr std::size_t numFreqs {150};
+    parameter_t freqs[numFreqs];
+    discriminator_t factors[numFreqs];
+
+    if (!std::strcmp(argv[1], "rk4"))
+        measure<RK4Detector>(nrml, sr, freqs, factors, numFreqs);
+    else if (!std::strcmp(argv[1], "cd"))
+        measure<CDDetector>(nrml, sr, freqs, factors, numFreqs);
+    else if (!std::strcmp(argv[1], "exact"))
+        measure<ExactDetector>(nrml, sr, freqs, factors, numFreqs);
+    else if (!std::strcmp(argv[1], "si"))
+        measure<SemiImplicitDetector>(nrml, sr, freqs, factors, numFreqs);
+    else {
+        std::cerr << "Unknown method " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::printf("    std::vector<parameter_t> {\n");
+    for (std::size_t n{0}; n < numFreqs; n++)
+        std::printf("        %s%s\n", repr(freqs[n]).c_str(),
+                    n+1 < numFreqs ? "," : "},");
+
+    std::printf("\n    std::vector<discriminator_t> {\n");
+    for (std::size_t n{0}; n < numFreqs; n++)
+        std::printf("        (%s%s%sj)%s\n", repr(factors[n].real()).c_str(),
+                    factors[n].imag() < 0 ? "" : "+",
+                    repr(factors[n].imag()).c_str(),
+                    n+1 < numFreqs ? "," : "},");
+
+    return 0;
+}
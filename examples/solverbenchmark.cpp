@@ -0,0 +1,136 @@
+/*
+ * Compare the accuracy and throughput of the numerical methods.
+ *
+ * Accuracy: a detector is driven by a two second tone at its own
+ * frequency and the magnitude of its output is compared, sample by
+ * sample, with that of a fourth order Runge-Kutta detector run at
+ * sixteen times the sample rate. The largest difference is given
+ * relative to the peak of the reference. Minimum-bandwidth detectors
+ * (central difference and exact linear methods) are only run with
+ * bandwidth 0.
+ *
+ * Throughput: an 88 channel piano-tuned bank of minimum-bandwidth
+ * detectors, and one of 5Hz bandwidth detectors, process ten seconds
+ * of a tone. The time per detector per sample is reported.
+ *
+ * Compile with
+ *   g++ -std=gnu++17 -O2 -I../src $(pkg-config --cflags fftw3f) solverbenchmark.cpp -ldetectorbank -pthread
+ */
+
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "detectorbank.h"
+#include "detectors.h"
+
+namespace {
+    constexpr parameter_t sr {48000.};
+    constexpr parameter_t d {0.0001};
+    constexpr parameter_t gain {25.};
+    constexpr std::size_t oversample {16};
+
+    std::vector<inputSample_t> tone(const parameter_t f, const parameter_t rate,
+                                    const std::size_t len)
+    {
+        std::vector<inputSample_t> t(len);
+        for (std::size_t i{0}; i < len; i++)
+            t[i] = gain * std::sin(2*M_PI*f*i/rate);
+        return t;
+    }
+
+    template <class Detector>
+    std::vector<discriminator_t> run(const parameter_t f, const parameter_t bw,
+                                     const parameter_t rate, const parameter_t damping,
+                                     const std::size_t len)
+    {
+        const std::vector<inputSample_t> input { tone(f, rate, len) };
+        std::vector<discriminator_t> z(len);
+        Detector det(f, 0., damping, rate, bw, gain);
+        det.processAudio(z.data(), input.data(), len);
+        return z;
+    }
+
+    template <class Detector>
+    double error(const parameter_t f, const parameter_t bw)
+    {
+        const std::size_t len { static_cast<std::size_t>(2*sr) };
+        // Same decay per second at the higher rate
+        const parameter_t dRef { 1. - std::pow(1.-d, 1./oversample) };
+
+        const std::vector<discriminator_t> ref {
+            run<RK4Detector>(f, bw, oversample*sr, dRef, oversample*len)
+        };
+        const std::vector<discriminator_t> z { run<Detector>(f, bw, sr, d, len) };
+
+        double peak {0}, err {0};
+        for (std::size_t i{0}; i < len; i++) {
+            const double r { std::abs(ref[i*oversample]) };
+            peak = std::max(peak, r);
+            err = std::max(err, std::abs(std::abs(z[i]) - r));
+        }
+        return err/peak;
+    }
+
+    double throughput(const DetectorBank::Features method, const parameter_t bw)
+    {
+        const std::size_t len { static_cast<std::size_t>(10*sr) };
+        const std::size_t chans {88};
+        const std::vector<inputSample_t> input { tone(440., sr, len) };
+        std::vector<parameter_t> freqs(chans), bws(chans, bw);
+        for (std::size_t c{0}; c < chans; c++)
+            freqs[c] = 27.5 * std::pow(2., c/12.);
+
+        DetectorBank db(sr, input.data(), len, 0, freqs.data(), bws.data(), chans,
+                        static_cast<DetectorBank::Features>(
+                            method | DetectorBank::Features::freq_unnormalized |
+                            DetectorBank::Features::amp_unnormalized),
+                        d, 1.);
+        std::unique_ptr<discriminator_t[]> z(new discriminator_t[chans*len]);
+
+        const auto start { std::chrono::steady_clock::now() };
+        db.getZ(z.get(), chans, len);
+        const std::chrono::duration<double, std::nano> elapsed {
+            std::chrono::steady_clock::now() - start
+        };
+        return elapsed.count() / (chans*len);
+    }
+}
+
+int main()
+{
+    const parameter_t freqs[] {100., 500., 1000., 2000.};
+    const parameter_t bws[] {0., 5., 20.};
+
+    std::printf("Largest error in |z| relative to oversampled Runge-Kutta\n");
+    std::printf("%8s %6s %12s %12s %12s %12s\n",
+                "f (Hz)", "bw", "runge_kutta", "semi_impl", "central_diff", "exact_lin");
+    for (const parameter_t f : freqs)
+        for (const parameter_t bw : bws) {
+            std::printf("%8g %6g %12.3g %12.3g", f, bw,
+                        error<RK4Detector>(f, bw), error<SemiImplicitDetector>(f, bw));
+            if (bw == 0.)
+                std::printf(" %12.3g %12.3g\n",
+                            error<CDDetector>(f, bw), error<ExactDetector>(f, bw));
+            else
+                std::printf(" %12s %12s\n", "-", "-");
+        }
+
+    std::printf("\nTime per detector per sample (ns), 88 channels\n");
+    std::printf("%6s %12s %12s %12s %12s\n",
+                "bw", "runge_kutta", "semi_impl", "central_diff", "exact_lin");
+    std::printf("%6g %12.3g %12.3g %12.3g %12.3g\n", 0.,
+                throughput(DetectorBank::Features::runge_kutta, 0.),
+                throughput(DetectorBank::Features::semi_implicit, 0.),
+                throughput(DetectorBank::Features::central_difference, 0.),
+                throughput(DetectorBank::Features::exact_linear, 0.));
+    std::printf("%6g %12.3g %12.3g %12s %12s\n", 5.,
+                throughput(DetectorBank::Features::runge_kutta, 5.),
+                throughput(DetectorBank::Features::semi_implicit, 5.),
+                "-", "-");
+
+    return 0;
+}
@@ -41,8 +41,8 @@ detector_characteristics : numpy.ndarray
     2D array of frequencies and bandwidths for each detector
 
 features : Features
-    Numerical method (runge_kutta or central_difference),
-    freqency normalisation (freq_unnormalized or search_normalized) and
+    Numerical method (runge_kutta, central_difference, exact_linear or
+    semi_implicit), freqency normalisation (freq_unnormalized or search_normalized) and
     amplitude normalisation (amp_unnormalized or amp_normalized). Default
     is runge_kutta|freq_unnormalized|amp_normalized. 
 
@@ -74,6 +74,9 @@ inputBuffer : numpy.ndarray
 
 Get the next numSamples of detector bank output.
 
+If frames has dtype complex64 rather than complex128, the detectors
+are advanced using single-precision arithmetic.
+
 Parameters
 ----------
 frames : numpy.ndarray
@@ -84,6 +87,83 @@ Returns
 Number of frames processed") DetectorBank::getZ;
 
 
+%feature("autodoc", "
+
+Get the magnitudes of the next numSamples of detector bank output.
+
+Equivalent to getZ followed by absZ, without the intermediate complex
+array. If absFrames has dtype float32 rather than float64, the detectors
+are advanced using single-precision arithmetic.
+
+Parameters
+----------
+absFrames : numpy.ndarray
+    Real 2D output array (channels x numSamples)
+
+startChan : int, optional
+    Channel from which to start
+
+maxima : numpy.ndarray, optional
+    Array with one element per channel of absFrames, of the same dtype.
+    Each element is raised to the largest magnitude written to its
+    channel.
+
+Returns
+-------
+Number of frames processed") DetectorBank::getAbsZ;
+
+%feature("autodoc", "
+
+Get every hop'th frame of the next numSamples*hop frames of detector
+bank output.
+
+The detectors run at the full sample rate, but only the first output
+of each hop is written. If frames has dtype complex64 rather than
+complex128, the detectors are advanced using single-precision arithmetic.
+
+Parameters
+----------
+frames : numpy.ndarray
+    Complex 2D output array (channels x numSamples)
+
+hop : int
+    Number of input samples per output frame
+
+startChan : int, optional
+    Channel from which to start
+
+Returns
+-------
+Number of output frames written") DetectorBank::getDecimatedZ;
+
+
+%feature("autodoc", "
+
+Get the next numSamples*hop frames of detector bank output as
+magnitudes pooled over each hop.
+
+Parameters
+----------
+absFrames : numpy.ndarray
+    Real 2D output array (channels x numSamples), float64 or float32
+
+hop : int
+    Number of input samples per output frame
+
+pooling : DetectorBank.max_abs or DetectorBank.mean_power
+    Whether each frame is the largest |z| or the mean of |z|**2 in its hop
+
+startChan : int, optional
+    Channel from which to start
+
+maxima : numpy.ndarray, optional
+    Array with one element per channel of absFrames, of the same dtype.
+    Each element is raised to the largest frame written to its channel.
+
+Returns
+-------
+Number of output frames written") DetectorBank::getPooledZ;
+
 %feature("autodoc", "
 
 Take (complex) z frames and fill a given array of the same dimensions
@@ -91,6 +171,8 @@ Take (complex) z frames and fill a given array of the same dimensions
 
 Also returns the maximum value in absFrames.
 
+The arrays may be either float64 and complex128, or float32 and complex64.
+
 Parameters
 ----------
 absFrames : numpy.ndarray
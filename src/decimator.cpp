@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "decimator.h"
+
+Decimator::Decimator(const std::size_t factor)
+    : factor(factor)
+    , half(factor > 1 ? tapsPerFactor * factor : 0)
+    , kernel(2*half + 1)
+{
+    // sin(pi k/factor)/(pi k), the response of an ideal low-pass filter
+    // cut off at sr/(2 factor), under a Blackman window
+    const std::size_t N {kernel.size()};
+    for (std::size_t n {0}; n < N; n++) {
+        const double k {static_cast<double>(n) - static_cast<double>(half)};
+        const double ideal {
+            k == 0 ? 1.0/factor : std::sin(M_PI*k/factor) / (M_PI*k)
+        };
+        const double alpha {N > 1 ? M_PI*n/(N-1) : 0.0};
+        const double window {
+            N > 1 ? 0.42 - 0.5*std::cos(2.*alpha) + 0.08*std::cos(4.*alpha) : 1.0
+        };
+        kernel[n] = ideal * window;
+    }
+
+    const inputSample_t sum {std::accumulate(kernel.begin(), kernel.end(), inputSample_t(0))};
+    for (inputSample_t& tap : kernel)
+        tap /= sum;
+}
+
+void Decimator::decimate(const inputSample_t* inputSignal,
+                         const std::size_t signalSize,
+                         inputSample_t* decimatedSignal) const
+{
+    for (std::size_t m {0}; m < decimatedSize(signalSize); m++) {
+        const std::size_t centre {m * factor};
+        // Taps which would read before the start or after the end of
+        // the signal are skipped
+        const std::size_t first {centre < half ? half - centre : 0};
+        const std::size_t last {std::min(kernel.size(), signalSize + half - centre)};
+        inputSample_t y {0};
+        for (std::size_t n {first}; n < last; n++)
+            y += kernel[n] * inputSignal[centre + n - half];
+        decimatedSignal[m] = y;
+    }
+}
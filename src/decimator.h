@@ -0,0 +1,56 @@
+#ifndef _DECIMATOR_H_
+#define _DECIMATOR_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "detectortypes.h"
+
+/*! Low-pass filter a signal and keep every factor'th sample of it, so
+ *  that detectors of low frequency may be run at a fraction of the
+ *  sample rate.
+ *
+ *  The filter is a Blackman-windowed sinc cut off at the Nyquist
+ *  frequency of the decimated signal. Only the samples which are kept
+ *  are filtered, and the filter is centred on each of them, so the
+ *  decimated signal is not delayed. Samples beyond the ends of the
+ *  signal are taken to be zero.
+ */
+class Decimator {
+public:
+    /*! Construct a Decimator
+     *  \param factor Ratio of the input and output sample rates
+     */
+    Decimator(const std::size_t factor);
+
+    /*! Number of samples kept from a signal
+     *  \param signalSize Size of the signal
+     */
+    std::size_t decimatedSize(const std::size_t signalSize) const
+    {
+        return (signalSize + factor - 1) / factor;
+    }
+
+    /*! Decimate a signal. Sample n of the output is found from sample
+     *  n*factor of the input.
+     *  \param inputSignal Signal to be decimated
+     *  \param signalSize Size of the input signal
+     *  \param decimatedSignal Output array of decimatedSize(signalSize)
+     *         samples
+     */
+    void decimate(const inputSample_t* inputSignal,
+                  const std::size_t signalSize,
+                  inputSample_t* decimatedSignal) const;
+
+    /*! Number of taps either side of the centre of the filter per unit
+     *  of the decimation factor */
+    static constexpr std::size_t tapsPerFactor { 4 };
+
+protected:
+    const std::size_t factor;  /*!< Decimation factor */
+    const std::size_t half;    /*!< Taps either side of the centre */
+    /*! Filter kernel of 2*half+1 taps, normalised to unit gain at 0Hz */
+    std::vector<inputSample_t> kernel;
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -13,6 +15,7 @@
 #include <cassert>
 #include <string>
 #include <map>
+#include <numeric>
 #include <stdexcept>
 #include <ctime>
 #include <list>
@@ -32,7 +35,14 @@
 
 #include "detectorbank.h"
 #include "detectors.h"
+#include "detectorbatch.h"
+#include "detectorscan.h"
+#include "decimator.h"
 #include "frequencyshifter.h"
+#include "hilbert.h"
+#include "normalisationcache.h"
+#include "normalisationtable.h"
+#include "pcmconverter.h"
 #include "profilemanager.h"
 
 DetectorBank::DetectorBank(const std::string& profile,
@@ -73,37 +83,57 @@ DetectorBank::DetectorBank(const parameter_t sr,
                            Features features,
                            parameter_t damping,
                            const parameter_t gain)
+    : DetectorBank(sr, operatingRate(sr), inputBuffer, inputBufferSize,
+                   numThreads, freqs, bw, numDetectors, features, damping, gain)
+{
+}
+
+DetectorBank::DetectorBank(const parameter_t inputRate,
+                           const parameter_t sr,
+                           const inputSample_t* inputBuffer,
+                           const std::size_t inputBufferSize,
+                           std::size_t numThreads,
+                           const parameter_t* freqs,
+                           parameter_t* bw,
+                           const std::size_t numDetectors,
+                           Features features,
+                           parameter_t damping,
+                           const parameter_t gain)
     : inBufSize(inputBufferSize)
     , inBuf(inputBuffer)
-    , threadPool(new ThreadPool(numThreads))
+    , threadPool(new ThreadPool(numThreads, features & Features::realtime))
     , currentSample(0)
     , d(damping)
     , sr(sr)
+    , inputRate(inputRate)
     , features(features)
     , bw(bw)
     , gain(gain)
     , auto_bw(false)
 {
-    // throw exception if sample rate is not 44100 or 48000
-    std::array<parameter_t, 2> valid_sr {44100., 48000.};
-
-    if (std::find(valid_sr.begin(), valid_sr.end(), sr) == valid_sr.end())
-         throw std::invalid_argument("Sample rate should be 44100 or 48000.");
+    // Input at other rates is resampled to the operating rate
+    if (sr != inputRate)
+        resampler.reset(new Resampler(inputRate, sr));
 
+    // Minimum bandwidths are held by the bank, which frees them
     if (bw == nullptr) {
-        bw = new parameter_t[numDetectors];
-        std::fill(&bw[0], &bw[numDetectors+1], 0);
+        this->bw = new parameter_t[numDetectors];
+        std::fill(&this->bw[0], &this->bw[numDetectors], 0);
+        bw = this->bw;
         auto_bw = true;
     };
 
     const int solver {features & solverMask};
     const int freq_normalization {features & freqNormalizationMask};
 
-    for (std::size_t i {0}; i < numDetectors; i++)
+    for (std::size_t i {0}; i < numDetectors; i++) {
         if (solver == 1 && bw[i] != 0)
             throw std::invalid_argument("Central difference can only be used for minimum bandwidth detectors.");
+        if (solver == Features::exact_linear && bw[i] != 0)
+            throw std::invalid_argument("Exact linear method can only be used for minimum bandwidth detectors.");
+    }
 
-    amplify(inBuf, inBufSize, gain);
+    prepareInput();
 
     setDBComponents(freqs, bw, numDetectors);
 
@@ -120,12 +150,82 @@ DetectorBank::DetectorBank(const parameter_t sr,
                   << inBufSize << " input samples.\n";
 #   endif
 
-    // Allocate Detectors
+    // Allocate Detectors, at the operating rate
     makeDetectors(numDetectors, 0, d, sr, features, gain);
 }
 
+DetectorBank::DetectorBank(const std::string& path,
+                           std::size_t numThreads,
+                           const parameter_t* freqs,
+                           parameter_t* bw,
+                           const std::size_t numDetectors,
+                           Features features,
+                           parameter_t damping,
+                           const parameter_t gain,
+                           const parameter_t sr)
+    : DetectorBank(std::unique_ptr<MappedInput>(new MappedInput(path, sr)),
+                   numThreads, freqs, bw, numDetectors, features, damping, gain)
+{
+}
+
+DetectorBank::DetectorBank(const parameter_t sr,
+                           const std::int16_t* inputBuffer,
+                           const std::size_t numFrames,
+                           const std::size_t numChannels,
+                           std::size_t numThreads,
+                           const parameter_t* freqs,
+                           parameter_t* bw,
+                           const std::size_t numDetectors,
+                           Features features,
+                           parameter_t damping,
+                           const parameter_t gain)
+    : DetectorBank(sr, nullptr, 0, numThreads, freqs, bw, numDetectors,
+                   features, damping, gain)
+{
+    setInputBuffer(inputBuffer, numFrames, numChannels);
+}
+
+DetectorBank::DetectorBank(const parameter_t sr,
+                           const std::int32_t* inputBuffer,
+                           const std::size_t numFrames,
+                           const std::size_t numChannels,
+                           const unsigned bits,
+                           std::size_t numThreads,
+                           const parameter_t* freqs,
+                           parameter_t* bw,
+                           const std::size_t numDetectors,
+                           Features features,
+                           parameter_t damping,
+                           const parameter_t gain)
+    : DetectorBank(sr, nullptr, 0, numThreads, freqs, bw, numDetectors,
+                   features, damping, gain)
+{
+    setInputBuffer(inputBuffer, numFrames, numChannels, bits);
+}
+
+DetectorBank::DetectorBank(std::unique_ptr<MappedInput> input,
+                           std::size_t numThreads,
+                           const parameter_t* freqs,
+                           parameter_t* bw,
+                           const std::size_t numDetectors,
+                           Features features,
+                           parameter_t damping,
+                           const parameter_t gain)
+    : DetectorBank(input->getSR(), input->data(), input->size(), numThreads,
+                   freqs, bw, numDetectors, features, damping, gain)
+{
+    // The shifted, decimated or resampled copies of the input have been
+    // made, so the pages of the file read to make them may go, and the
+    // file is only kept if the detectors read it
+    input->release(0, input->size());
+    if (inBuf == input->data())
+        mapped = std::move(input);
+}
+
 DetectorBank::~DetectorBank()
 {
+    stopNormalisation();
+
     if (auto_bw)
         delete[] bw;
 
@@ -143,6 +243,10 @@ void DetectorBank::setDBComponents(const parameter_t* frequencies,
         {runge_kutta|search_normalized,        2200.},    //  24000.},//    
         {central_difference|freq_unnormalized, 500.},     //  24000.},//    
         {central_difference|search_normalized, 700.},     //  24000.},//    
+        {exact_linear|freq_unnormalized,       4000.},
+        {exact_linear|search_normalized,       4000.},
+        {semi_implicit|freq_unnormalized,      4000.},
+        {semi_implicit|search_normalized,      4000.},
     };
 
     modF = modFmap.at(features & (solverMask|freqNormalizationMask));
@@ -152,6 +256,10 @@ void DetectorBank::setDBComponents(const parameter_t* frequencies,
 
     // determine modulation criteria from features
     FrequencyShifter* fs {nullptr};
+    // when shifting on the fly, all the shifted channels read the
+    // Hilbert transform of the input instead of shifted copies of it
+    const bool onTheFly {(features & Features::shift_on_the_fly) != 0};
+    hilbertSignal.reset();
 
     for (std::size_t i {0}; i < numDetectors; i++) {
 
@@ -174,6 +282,22 @@ void DetectorBank::setDBComponents(const parameter_t* frequencies,
                 dbComponents[i].signal = inBuf;
         }
 
+        else if (onTheFly) {
+            parameter_t f_shift = - n * modF + 50.;
+
+            if (!hilbertSignal) {
+                hilbertSignal.reset(new inputSample_t[inBufSize]);
+                HilbertFIR().transform(inBuf, hilbertSignal.get(), inBufSize);
+            }
+            if (make_freqs)
+                dbComponents.push_back(detector_components{frequencies[i], frequencies[i]+f_shift,
+                                                            inBuf, bandwidths[i]});
+            else
+                dbComponents[i].signal = inBuf;
+            dbComponents[i].hilbert = hilbertSignal.get();
+            dbComponents[i].shift = FrequencyShift(f_shift, sr);
+        }
+
         else {
             if (fs == nullptr)
                 fs = new FrequencyShifter (inBuf, inBufSize, sr, mode);
@@ -196,6 +320,180 @@ void DetectorBank::setDBComponents(const parameter_t* frequencies,
     if (fs != nullptr)
         delete fs;
 
+    // With multirate, detectors far below modF read a decimated copy of
+    // their signal, shared by all those reading the same signal at the
+    // same rate
+    decimated_pool.clear();
+    if (features & Features::multirate) {
+        for (detector_components& component : dbComponents) {
+            if (make_freqs && !component.hilbert)
+                component.decimation = decimationFor(component.f_actual, component.bandwidth);
+            if (component.decimation == 1)
+                continue;
+
+            const std::pair<const inputSample_t*, std::size_t> key {
+                component.signal, component.decimation
+            };
+            if (decimated_pool.find(key) == decimated_pool.end()) {
+                const Decimator decimator(component.decimation);
+                decimated_pool[key].reset(new inputSample_t[decimator.decimatedSize(inBufSize)]);
+                decimator.decimate(component.signal, inBufSize, decimated_pool[key].get());
+            }
+            component.signal = decimated_pool[key].get();
+        }
+
+        // Shifted copies which are only read decimated are no longer needed
+        for (auto it = input_pool.begin(); it != input_pool.end(); ) {
+            const bool used {
+                std::any_of(dbComponents.begin(), dbComponents.end(),
+                            [&](const detector_components& component) {
+                                return component.signal == it->second.get();
+                            })
+            };
+            it = used ? std::next(it) : input_pool.erase(it);
+        }
+    }
+
+    startStream();
+}
+
+void DetectorBank::startStream()
+{
+    // The stream is shifted as the input buffer is, by the shifts of
+    // the channels at or above modF
+    std::map<int, int> shifts;
+    std::vector<parameter_t> fShifts;
+    stream.shift.clear();
+    for (const detector_components& component : dbComponents) {
+        const int n ( component.f_in / modF );
+        if (n == 0)
+            stream.shift.push_back(-1);
+        else {
+            if (shifts.find(n) == shifts.end()) {
+                shifts[n] = fShifts.size();
+                fShifts.push_back(- n * modF + 50.);
+            }
+            stream.shift.push_back(shifts[n]);
+        }
+    }
+
+    if (fShifts.empty())
+        stream.shifter.reset();
+    else
+        stream.shifter.reset(new FrequencyShifterStream(sr, fShifts));
+    if (resampler)
+        resampler->reset();
+    stream.input.clear();
+    stream.reserved = 0;
+    stream.delayed.clear();
+    stream.shifted.assign(fShifts.size(), std::vector<inputSample_t>());
+    stream.targets.assign(fShifts.size(), nullptr);
+    reserveStream(getLatency());
+}
+
+void DetectorBank::reserveStream(const std::size_t numSamples)
+{
+    if (stream.reserved >= numSamples)
+        return;
+
+    stream.reserved = numSamples;
+    if (resampler)
+        stream.input.resize(numSamples);
+    if (stream.shifter) {
+        stream.shifter->reserve(numSamples);
+        stream.delayed.resize(numSamples);
+        for (std::size_t s {0}; s < stream.shifted.size(); s++) {
+            stream.shifted[s].resize(numSamples);
+            stream.targets[s] = stream.shifted[s].data();
+        }
+    }
+}
+
+int DetectorBank::process(const inputSample_t* input, const std::size_t numSamples,
+                          discriminator_t* frames)
+{
+    if (features & Features::multirate)
+        throw std::runtime_error("process() can't be used with the multirate feature");
+
+    const std::size_t numFrames { getBlockFrames(numSamples) };
+    reserveStream(numFrames);
+
+    // The block is read where it is unless it has to be resampled
+    if (!resampler)
+        return processBlock(input, numSamples, frames, numFrames);
+
+    const std::size_t count {
+        resampler->push(input, numSamples, stream.input.data())
+    };
+    return processBlock(stream.input.data(), count, frames, numFrames);
+}
+
+int DetectorBank::flush(discriminator_t* frames)
+{
+    if (features & Features::multirate)
+        throw std::runtime_error("flush() can't be used with the multirate feature");
+
+    // The end of the resampled input is shifted and run first, then
+    // the end of the shifted input
+    int done {0};
+    if (resampler)
+        done = processBlock(stream.input.data(), resampler->flush(stream.input.data()),
+                            frames, getLatency());
+
+    if (!stream.shifter)
+        return done;
+
+    const std::size_t ready {
+        stream.shifter->flush(stream.delayed.data(), stream.targets.data())
+    };
+    return done + runStream(stream.delayed.data(), ready, frames + done, getLatency());
+}
+
+int DetectorBank::processBlock(const inputSample_t* signal, const std::size_t numSamples,
+                               discriminator_t* frames, const std::size_t numFrames)
+{
+    if (!stream.shifter)
+        return runStream(signal, numSamples, frames, numFrames);
+
+    const std::size_t ready {
+        stream.shifter->push(signal, numSamples,
+                             stream.delayed.data(), stream.targets.data())
+    };
+    return runStream(stream.delayed.data(), ready, frames, numFrames);
+}
+
+std::size_t DetectorBank::getLatency(void) const
+{
+    return (resampler ? resampler->latency() : 0) +
+           (stream.shifter ? stream.shifter->latency() : 0);
+}
+
+std::size_t DetectorBank::getBlockFrames(const std::size_t numSamples) const
+{
+    return resampler ? resampler->maxOutput(numSamples) : numSamples;
+}
+
+int DetectorBank::runStream(const inputSample_t* signal, const std::size_t numSamples,
+                            discriminator_t* frames, const std::size_t numFrames)
+{
+    // The stream is shifted by its own shifter, even with shift_on_the_fly
+    for (std::size_t c {0}; c < dbComponents.size(); c++) {
+        dbComponents[c].signal =
+            stream.shift[c] < 0 ? signal : stream.targets[stream.shift[c]];
+        dbComponents[c].hilbert = nullptr;
+    }
+
+    // The block is run as though it were the whole input buffer, which
+    // is then left empty
+    mapped.reset();
+    convertedBuf.reset();
+    inBuf = signal;
+    inBufSize = numSamples;
+    currentSample = 0;
+    const int done { getZ(frames, detectors.size(), numFrames) };
+    inBufSize = 0;
+    currentSample = 0;
+    return done;
 }
 
 void DetectorBank::setInputBuffer(const inputSample_t* inputBuffer,
@@ -203,7 +501,9 @@ void DetectorBank::setInputBuffer(const inputSample_t* inputBuffer,
 {
     inBufSize = inputBufferSize;
     inBuf = inputBuffer;
-    amplify(inBuf, inBufSize, gain);
+    mapped.reset();
+    convertedBuf.reset();
+    prepareInput();
     currentSample = 0;
     // Delete frequency-shifted copies of the input buffer
     input_pool.clear();
@@ -211,23 +511,72 @@ void DetectorBank::setInputBuffer(const inputSample_t* inputBuffer,
     setDBComponents(nullptr, nullptr, detectors.size());
 }
 
-void DetectorBank::amplify(const inputSample_t*& signal,
-                           std::size_t signalSize,
-                           const parameter_t gain)
+void DetectorBank::setInputBuffer(const inputSample_t* inputBuffer,
+                                  const std::size_t numFrames,
+                                  const std::size_t numChannels)
 {
-    if (gain != 1.0) {
-        gainBuf = std::move(
-            std::unique_ptr<inputSample_t[]>(new inputSample_t[signalSize])
-        );
-        // Copy input signal into new "gain buffer"
-        // resetting signal to point at the amplified version
-        const inputSample_t* inbuf { signal };
-        inputSample_t* gbuf { gainBuf.get() };
-        signal = gbuf;
-        while (signalSize--)
-            *gbuf++ = *inbuf++ * gain;
-//             *signal++ *= gain;
+    std::unique_ptr<inputSample_t[]> mono {new inputSample_t[numFrames]};
+    PCMConverter::convert(inputBuffer, numFrames, numChannels, mono.get());
+    setConvertedInput(std::move(mono), numFrames);
+}
+
+void DetectorBank::setInputBuffer(const std::int16_t* inputBuffer,
+                                  const std::size_t numFrames,
+                                  const std::size_t numChannels)
+{
+    std::unique_ptr<inputSample_t[]> mono {new inputSample_t[numFrames]};
+    PCMConverter::convert(inputBuffer, numFrames, numChannels, mono.get());
+    setConvertedInput(std::move(mono), numFrames);
+}
+
+void DetectorBank::setInputBuffer(const std::int32_t* inputBuffer,
+                                  const std::size_t numFrames,
+                                  const std::size_t numChannels,
+                                  const unsigned bits)
+{
+    std::unique_ptr<inputSample_t[]> mono {new inputSample_t[numFrames]};
+    PCMConverter::convert(inputBuffer, numFrames, numChannels, mono.get(), bits);
+    setConvertedInput(std::move(mono), numFrames);
+}
+
+void DetectorBank::setConvertedInput(std::unique_ptr<inputSample_t[]> mono,
+                                     const std::size_t numSamples)
+{
+    setInputBuffer(mono.get(), numSamples);
+    if (inBuf == mono.get())
+        convertedBuf = std::move(mono);
+}
+
+void DetectorBank::prepareInput(void)
+{
+    // Otherwise the input is read where it is, the gain being applied
+    // by the detectors as they read it
+    if (!resampler) {
+        resampledBuf.reset();
+        return;
+    }
+
+    resampledBuf.reset(new inputSample_t[resampler->maxOutput(inBufSize) + resampler->latency()]);
+    resampler->reset();
+    std::size_t count { resampler->push(inBuf, inBufSize, resampledBuf.get()) };
+    count += resampler->flush(resampledBuf.get() + count);
+    inBuf = resampledBuf.get();
+    inBufSize = count;
+}
+
+parameter_t DetectorBank::operatingRate(const parameter_t inputRate)
+{
+    parameter_t best {0};
+    std::size_t bestTerms {0};
+    for (const parameter_t rate : {48000., 44100.}) {
+        std::size_t up, down;
+        Resampler::ratio(inputRate, rate, up, down);
+        if (best == 0 || std::max(up, down) < bestTerms) {
+            best = rate;
+            bestTerms = std::max(up, down);
+        }
     }
+    return best;
 }
 
 void DetectorBank::makeDetectors(const std::size_t numDetectors,
@@ -238,11 +587,11 @@ void DetectorBank::makeDetectors(const std::size_t numDetectors,
                                  const parameter_t gain
                                 )
 {
-    AbstractDetector *detector;
-
     const int solver {features & solverMask};
     assert(solver == Features::central_difference ||
-           solver == Features::runge_kutta);
+           solver == Features::runge_kutta        ||
+           solver == Features::exact_linear       ||
+           solver == Features::semi_implicit);
 
     const int freq_normalization {features & freqNormalizationMask};
     assert(freq_normalization == Features::freq_unnormalized     ||
@@ -252,6 +601,23 @@ void DetectorBank::makeDetectors(const std::size_t numDetectors,
     assert(amp_normalization == Features::amp_unnormalized     ||
            amp_normalization == Features::amp_normalized);
 
+    // getZ() runs a version of runDetectors() specialised for the
+    // numerical method, so the method needn't be rediscovered per call
+    switch (solver) {
+    case Features::central_difference:
+        selectSolver<CDDetector>();
+        break;
+    case Features::runge_kutta:
+        selectSolver<RK4Detector>();
+        break;
+    case Features::exact_linear:
+        selectSolver<ExactDetector>();
+        break;
+    case Features::semi_implicit:
+        selectSolver<SemiImplicitDetector>();
+        break;
+    }
+
 #   if (DEBUG & 2)
         std::ofstream zf;
         zf.open("/tmp/z.dat", std::ofstream::out | std::ofstream::app);
@@ -263,48 +629,337 @@ void DetectorBank::makeDetectors(const std::size_t numDetectors,
         zf << "-------- " << buf << " --------\n";
 #   endif
 
-    for (std::size_t i{0}; i < numDetectors; i++) {
-        const parameter_t f = dbComponents.empty() ? 0 : dbComponents[i].f_actual;
-        const parameter_t f_in = dbComponents.empty() ? 0 : dbComponents[i].f_in;
-        const parameter_t det_bw = dbComponents.empty() ? 0 : dbComponents[i].bandwidth;
-
-        switch (solver & method_mask) {
-        case Features::central_difference:
-            detector = new CDDetector(f, mu, d, sr, det_bw, gain);
-            break;
-        case Features::runge_kutta:
-            detector = new RK4Detector(f, mu, d, sr, det_bw, gain);
-            break;
-        default:
-            detector = nullptr;
+    // With deferred normalisation the detectors are made unnormalised,
+    // so the bank can be used at once, and normalised detectors are made
+    // on another thread only to find the corrections to be applied to them
+    const bool deferred {
+        (features & Features::deferred_normalization) &&
+        !dbComponents.empty() &&
+        (freq_normalization == Features::search_normalized ||
+         amp_normalization == Features::amp_normalized)
+    };
+    const Features unnormalized {
+        static_cast<Features>(solver | Features::freq_unnormalized |
+                              Features::amp_unnormalized)
+    };
+
+    std::vector<std::unique_ptr<AbstractDetector>> made(numDetectors);
+    buildDetectors(made, *threadPool, mu, d, sr,
+                   deferred ? unnormalized : features, gain, false);
+    for (auto& detector : made)
+        detectors.push_back(std::move(detector));
+    channelCost.assign(detectors.size(), 0);
+    // getZ's job descriptors are made here, so it needn't allocate them
+    channelOrder.reserve(detectors.size());
+    jobs.reserve(detectors.size());
+    jobArgs.reserve(detectors.size());
+    jobCosts.reserve(detectors.size());
+
+    // getZ's scan descriptors are made here, so it needn't allocate them.
+    // A scan has at least two blocks per channel and at most one
+    // block per thread (see scanChannels)
+    scanStates.reset(new std::complex<parameter_t>[threadPool->threads][2]);
+    scanParams.reserve(threadPool->threads);
+    scanArgs.reserve(threadPool->threads);
+    scanFirstPass.reserve(threadPool->threads);
+
+    if (deferred) {
+        normalisationsFound = 0;
+        normalisationsDue = numDetectors;
+        stopNormaliser = false;
+        const std::size_t threads { threadPool->threads };
+        normaliser = std::thread(
+            [this, numDetectors, threads, mu, d, sr, features, gain]() {
+                ThreadPool pool(threads);
+                std::vector<std::unique_ptr<AbstractDetector>> normalised(numDetectors);
+                try {
+                    buildDetectors(normalised, pool, mu, d, sr, features, gain, true);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(normalisationMutex);
+                    normalisationError = std::current_exception();
+                }
+            });
+    }
+}
+
+void DetectorBank::buildDetectors(std::vector<std::unique_ptr<AbstractDetector>>& made,
+                                  ThreadPool& pool,
+                                  const parameter_t mu,
+                                  const parameter_t d,
+                                  const parameter_t sr,
+                                  const Features features,
+                                  const parameter_t gain,
+                                  const bool deferred
+                                 )
+{
+    const std::size_t numDetectors { made.size() };
+    const int freq_normalization {features & freqNormalizationMask};
+
+    // Each detector is constructed and normalised independently, so
+    // the work is shared among the threads. Every job repeatedly takes
+    // the next detector not yet claimed, as normalisation times vary,
+    // and stores it in its own place so the order is that of the channels.
+    // Frequency correction expected of each detector, or 0 if unknown
+    std::vector<parameter_t> guess(numDetectors, 0);
+
+    auto makeAll {
+        [&](const std::vector<std::size_t>& channels) {
+            std::atomic<std::size_t> next {0};
+            auto delegate {
+                [&](void*) {
+                    for (std::size_t n; !(deferred && stopNormaliser) &&
+                                        (n = next++) < channels.size(); ) {
+                        const std::size_t i { channels[n] };
+                        made[i].reset(makeDetector(i, mu, d, sr, features, gain, guess[i]));
+                        if (deferred)
+                            publishNormalisation(i, made[i]->getNormalisation());
+                    }
+                }
+            };
+            const std::size_t jobs { std::min(pool.threads, channels.size()) };
+            std::vector<void*> threadArgs(jobs, nullptr);
+            pool.manifold(delegate, threadArgs.data(), jobs);
         }
+    };
 
-        // Perform nomalizations for frequencies and amplitudes.
-        // Currently there's only one of each. Additional types and range
-        // masks should be created in detectorbank.h
-        
-        if (!dbComponents.empty()) {
-            switch (freq_normalization & frequency_normalization_mask) {
-                case Features::search_normalized:
-                    // Make three test tones and iterate by best-fit
-                    // parabola search to find the best response.
-                    // Parameters are f0, start and end freq wrt w0,
-                    // tone duration and target amplitude.
-                    detector->searchNormalize(0.92, 1.08, 3.0, gain);
-                    break;
+    if (freq_normalization == Features::search_normalized && !dbComponents.empty()) {
+        // The corrections found by search normalisation change slowly with
+        // frequency, so a search near the correction of neighbouring
+        // detectors is much shorter. Every searchSeedSpacing'th detector
+        // of each bandwidth, in order of frequency, is made first (as are
+        // the highest and lowest), then the corrections of the rest are
+        // interpolated from these. This is independent of the number of
+        // threads, so the detectors made are too.
+        // Detectors run at different rates have different corrections,
+        // so are grouped by rate as well as bandwidth
+        std::map<std::pair<parameter_t, std::size_t>, std::vector<std::size_t>> byBandwidth;
+        for (std::size_t i {0}; i < numDetectors; i++)
+            byBandwidth[{dbComponents[i].bandwidth, dbComponents[i].decimation}].push_back(i);
+
+        std::vector<std::size_t> seeds, others;
+        for (auto& group : byBandwidth) {
+            std::vector<std::size_t>& channels { group.second };
+            std::stable_sort(channels.begin(), channels.end(),
+                             [&](std::size_t a, std::size_t b) {
+                                 return dbComponents[a].f_actual < dbComponents[b].f_actual;
+                             });
+            for (std::size_t n {0}; n < channels.size(); n++)
+                if (n % searchSeedSpacing == 0 || n == channels.size() - 1)
+                    seeds.push_back(channels[n]);
+                else
+                    others.push_back(channels[n]);
+        }
+        makeAll(seeds);
+        if (deferred && stopNormaliser) {
+            NormalisationCache::instance().flush();
+            return;
+        }
+
+        auto correction {
+            [&](std::size_t i) {
+                return made[i]->getW() / (2.0*M_PI*dbComponents[i].f_actual);
             }
-            switch (amp_normalization & amplitude_normalisation_mask) {
-                case Features::amp_normalized:
-                    detector->amplitudeNormalize(gain);
-                    break;
+        };
+        for (auto& group : byBandwidth) {
+            const std::vector<std::size_t>& channels { group.second };
+            for (std::size_t n {0}; n < channels.size(); n++) {
+                if (n % searchSeedSpacing == 0 || n == channels.size() - 1)
+                    continue;
+                const std::size_t below { channels[n - n % searchSeedSpacing] };
+                const std::size_t above {
+                    channels[std::min(n - n % searchSeedSpacing + searchSeedSpacing,
+                                      channels.size() - 1)]
+                };
+                const parameter_t fBelow { dbComponents[below].f_actual };
+                const parameter_t fAbove { dbComponents[above].f_actual };
+                const parameter_t x {
+                    fAbove > fBelow ?
+                        std::log(dbComponents[channels[n]].f_actual / fBelow) /
+                            std::log(fAbove / fBelow) :
+                        0.0
+                };
+                guess[channels[n]] = (1 - x) * correction(below) + x * correction(above);
             }
         }
-        
-        if (!dbComponents.empty()) 
-            detector->scaleAmplitude();
+        makeAll(others);
+    }
+    else {
+        std::vector<std::size_t> channels(numDetectors);
+        std::iota(channels.begin(), channels.end(), 0);
+        makeAll(channels);
+    }
+    // The normalisations found are written to the cache file together
+    NormalisationCache::instance().flush();
+}
+
+AbstractDetector* DetectorBank::makeDetector(const std::size_t i,
+                                             const parameter_t mu,
+                                             const parameter_t d,
+                                             const parameter_t sr,
+                                             const Features features,
+                                             const parameter_t gain,
+                                             const parameter_t guess
+                                            )
+{
+    AbstractDetector *detector;
+
+    const int solver {features & solverMask};
+    const int freq_normalization {features & freqNormalizationMask};
+    const int amp_normalization {features & ampNormalizationMask};
+
+    const parameter_t f = dbComponents.empty() ? 0 : dbComponents[i].f_actual;
+    const parameter_t det_bw = dbComponents.empty() ? 0 : dbComponents[i].bandwidth;
+    // A detector reading decimated input runs at the decimated rate.
+    // Its damping, which is applied at every step, is that of the steps
+    // of the full rate it takes the place of
+    const std::size_t decimation = dbComponents.empty() ? 1 : dbComponents[i].decimation;
+    const parameter_t rate = sr / decimation;
+    const parameter_t damping = decimation == 1 ? d : 1. - std::pow(1. - d, decimation);
+
+    switch (solver & method_mask) {
+    case Features::central_difference:
+        detector = new CDDetector(f, mu, damping, rate, det_bw, gain);
+        break;
+    case Features::runge_kutta:
+        detector = new RK4Detector(f, mu, damping, rate, det_bw, gain);
+        break;
+    case Features::exact_linear:
+        detector = new ExactDetector(f, mu, damping, rate, det_bw, gain);
+        break;
+    case Features::semi_implicit:
+        detector = new SemiImplicitDetector(f, mu, damping, rate, det_bw, gain);
+        break;
+    default:
+        detector = nullptr;
+    }
+
+    // Perform nomalizations for frequencies and amplitudes.
+    // Currently there's only one of each. Additional types and range
+    // masks should be created in detectorbank.h
+    
+    // Normalisation is slow, so its results are tabulated for common
+    // nonlinear detectors and are kept for reuse
+    const NormalisationCache::Key key {
+        solver | freq_normalization | amp_normalization,
+        rate, f, det_bw, mu, damping, gain
+    };
+    NormalisationCache::Value cached;
+    const bool normalize {
+        !dbComponents.empty() &&
+        (freq_normalization == Features::search_normalized ||
+         amp_normalization == Features::amp_normalized)
+    };
+
+    if (normalize && (NormalisationTable::find(key, cached) ||
+                      NormalisationCache::instance().find(key, cached)))
+        detector->setNormalisation(cached,
+                                   freq_normalization == Features::search_normalized);
+    else if (normalize) {
+        // The normalisation of a linear detector is calculated from its
+        // steady-state response; other detectors are run on test tones
+        const bool linear { detector->isLinear() };
+        switch (freq_normalization & frequency_normalization_mask) {
+            case Features::search_normalized:
+                // Search near the expected correction, if there is one,
+                // then over the full range.
+                // Parameters are start and end freq wrt f0,
+                // tone duration and target amplitude.
+                if (linear ?
+                        !detector->analyticSearchNormalize(0.92, 1.08) :
+                        !(guess > 0 &&
+                          detector->searchNormalize(guess / warmSearchRange,
+                                                    guess * warmSearchRange, 3.0, gain)) &&
+                        !detector->searchNormalize(0.92, 1.08, 3.0, gain))
+                    std::cout << "Searching for normalized characteristic frequency: "
+                                 "test range does not span maximum response.\n";
+                break;
+        }
+        switch (amp_normalization & amplitude_normalisation_mask) {
+            case Features::amp_normalized:
+                if (linear)
+                    detector->analyticAmplitudeNormalize(gain);
+                else
+                    detector->amplitudeNormalize(gain);
+                break;
+        }
+        NormalisationCache::instance().insert(key, detector->getNormalisation());
+    }
+    
+    if (!dbComponents.empty()) 
+        detector->scaleAmplitude();
+
+    return detector;
+}
+
+void DetectorBank::publishNormalisation(const std::size_t i,
+                                        const NormalisationCache::Value& value)
+{
+    {
+        std::lock_guard<std::mutex> lock(normalisationMutex);
+        pendingNormalisations.emplace_back(i, value);
+        normalisationsFound++;
+    }
+    reportNormalisation();
+}
+
+void DetectorBank::applyNormalisations()
+{
+    std::lock_guard<std::mutex> lock(normalisationMutex);
+    if (normalisationError)
+        std::rethrow_exception(std::exchange(normalisationError, nullptr));
+
+    const bool searched {
+        (features & freqNormalizationMask) == Features::search_normalized
+    };
+    for (const auto& pending : pendingNormalisations) {
+        detectors[pending.first]->setNormalisation(pending.second, searched);
+        detectors[pending.first]->scaleAmplitude();
+    }
+    pendingNormalisations.clear();
+}
+
+void DetectorBank::reportNormalisation()
+{
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    if (normalisationCallback)
+        normalisationCallback(normalisationsFound, normalisationsDue);
+}
+
+void DetectorBank::stopNormalisation()
+{
+    stopNormaliser = true;
+    if (normaliser.joinable())
+        normaliser.join();
+
+    std::lock_guard<std::mutex> lock(normalisationMutex);
+    pendingNormalisations.clear();
+    normalisationError = nullptr;
+    normalisationsFound = 0;
+    normalisationsDue = 0;
+}
+
+bool DetectorBank::isNormalised() const
+{
+    std::lock_guard<std::mutex> lock(normalisationMutex);
+    return normalisationsFound == normalisationsDue && pendingNormalisations.empty();
+}
+
+void DetectorBank::waitForNormalisation()
+{
+    if (normaliser.joinable())
+        normaliser.join();
+    applyNormalisations();
+}
 
-        detectors.push_back(std::unique_ptr<AbstractDetector>(detector));
+void DetectorBank::setNormalisationCallback(std::function<void(std::size_t, std::size_t)> callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(callbackMutex);
+        normalisationCallback = std::move(callback);
     }
+    if (normalisationsDue)
+        reportNormalisation();
 }
 
 int DetectorBank::getZ(discriminator_t* frames,
@@ -312,7 +967,118 @@ int DetectorBank::getZ(discriminator_t* frames,
                        const std::size_t startChan
                       )
 {
-    const size_t maxThreads {threadPool->threads}; // should probably make this an argument
+    return (this->*runDetectorsDouble)(GetZ_output<double> { frames, nullptr, nullptr, 1, max_abs },
+                                       chans, numFrames, startChan);
+}
+
+int DetectorBank::getZ(discriminatorf_t* frames,
+                       std::size_t chans, std::size_t numFrames,
+                       const std::size_t startChan
+                      )
+{
+    return (this->*runDetectorsSingle)(GetZ_output<float> { frames, nullptr, nullptr, 1, max_abs },
+                                       chans, numFrames, startChan);
+}
+
+int DetectorBank::getAbsZ(result_t* absFrames,
+                          std::size_t absChans, std::size_t absNumFrames,
+                          const std::size_t startChan,
+                          result_t* maxima
+                         )
+{
+    return (this->*runDetectorsDouble)(GetZ_output<double> { nullptr, absFrames, maxima, 1, max_abs },
+                                       absChans, absNumFrames, startChan);
+}
+
+int DetectorBank::getAbsZ(resultf_t* absFrames,
+                          std::size_t absChans, std::size_t absNumFrames,
+                          const std::size_t startChan,
+                          resultf_t* maxima
+                         )
+{
+    return (this->*runDetectorsSingle)(GetZ_output<float> { nullptr, absFrames, maxima, 1, max_abs },
+                                       absChans, absNumFrames, startChan);
+}
+
+int DetectorBank::getDecimatedZ(discriminator_t* frames,
+                                std::size_t chans, std::size_t numFrames,
+                                const std::size_t hop,
+                                const std::size_t startChan
+                               )
+{
+    return (this->*runDetectorsDouble)(GetZ_output<double> { frames, nullptr, nullptr,
+                                                             std::max(hop, std::size_t(1)),
+                                                             max_abs },
+                                       chans, numFrames, startChan);
+}
+
+int DetectorBank::getDecimatedZ(discriminatorf_t* frames,
+                                std::size_t chans, std::size_t numFrames,
+                                const std::size_t hop,
+                                const std::size_t startChan
+                               )
+{
+    return (this->*runDetectorsSingle)(GetZ_output<float> { frames, nullptr, nullptr,
+                                                            std::max(hop, std::size_t(1)),
+                                                            max_abs },
+                                       chans, numFrames, startChan);
+}
+
+int DetectorBank::getPooledZ(result_t* absFrames,
+                             std::size_t absChans, std::size_t absNumFrames,
+                             const std::size_t hop,
+                             const Pooling pooling,
+                             const std::size_t startChan,
+                             result_t* maxima
+                            )
+{
+    return (this->*runDetectorsDouble)(GetZ_output<double> { nullptr, absFrames, maxima,
+                                                             std::max(hop, std::size_t(1)),
+                                                             pooling },
+                                       absChans, absNumFrames, startChan);
+}
+
+int DetectorBank::getPooledZ(resultf_t* absFrames,
+                             std::size_t absChans, std::size_t absNumFrames,
+                             const std::size_t hop,
+                             const Pooling pooling,
+                             const std::size_t startChan,
+                             resultf_t* maxima
+                            )
+{
+    return (this->*runDetectorsSingle)(GetZ_output<float> { nullptr, absFrames, maxima,
+                                                            std::max(hop, std::size_t(1)),
+                                                            pooling },
+                                       absChans, absNumFrames, startChan);
+}
+
+template <class Solver>
+void DetectorBank::selectSolver()
+{
+    runDetectorsDouble = &DetectorBank::runDetectors<Solver, double>;
+    runDetectorsSingle = &DetectorBank::runDetectors<Solver, float>;
+
+    std::shared_ptr<std::vector<DetectorScan<Solver>>> store {
+        std::make_shared<std::vector<DetectorScan<Solver>>>()
+    };
+    store->reserve(threadPool->threads / 2);
+    scans = store;
+}
+
+template <class Solver, typename T>
+int DetectorBank::runDetectors(const GetZ_output<T>& out,
+                               std::size_t chans, std::size_t numFrames,
+                               const std::size_t startChan
+                              )
+{
+    // Deferred normalisations found since the last call take effect now,
+    // so that every detector runs with one set of coefficients per call
+    if (normaliser.joinable()) {
+        applyNormalisations();
+        if (isNormalised())
+            normaliser.join();
+    }
+
     const size_t numDetectors ( detectors.size() );
 
 #   if (DEBUG & 1)
@@ -327,74 +1093,271 @@ int DetectorBank::getZ(discriminator_t* frames,
 
     // Don't try to run past the end of the buffer
     // or exceed the number of available channels
-    std::size_t framesToDo(std::min(numFrames, inBufSize-currentSample));
+    std::size_t framesToDo(std::min(numFrames*out.hop, inBufSize-currentSample));
+    const std::size_t framesOut { (framesToDo + out.hop-1) / out.hop };
     chans = std::min(static_cast<std::size_t>(chans), numDetectors);
 
-    // Each thread in general processes chansPerThread channels
-    // but if chans isn't divisible exactly by 'maxThreads',
-    // the first 'extra' threads will have to do an additional channel each.
-    const std::size_t chansPerThread { chans/maxThreads };
-    const std::size_t extra { chans%maxThreads };
-    void* threadArgs[maxThreads];
-    // Small datasets may not use all threads.
-    std::size_t numThreads {0};
-
-    for (unsigned int t {0}, startChannel {0}; t < maxThreads; t++) {
-        const std::size_t chansThisThread {
-            (t < extra) ? chansPerThread + 1 : chansPerThread
-        };
+    // With fewer channels than threads, linear detectors may have
+    // their time ranges divided between the threads instead.
+    // A mapped input file is read ahead of the detectors
+    if (mapped)
+        mapped->willNeed(currentSample, framesToDo);
 
-        if (chansThisThread && framesToDo) {
-#           if (DEBUG & 1)
-                std::cout << "Thread " << t
-                            << " starts with channel " << startChannel
-                            << " for " << chansThisThread
-                            << std::endl;
-#           endif
-
-            threadArgs[t] = new GetZ_params { startChannel,
-                                              chansThisThread,
-                                              frames,
-                                              numFrames,
-                                              framesToDo };
-            numThreads++;
-        }
-        startChannel += chansThisThread;
+    if (scanChannels<Solver>(out, chans, numFrames, framesToDo)) {
+        advance(framesToDo);
+        return framesOut;
+    }
+
+    if (!framesToDo || !chans) {
+        advance(framesToDo);
+        return framesOut;
     }
 
-    auto delegate { [this](void* args){ getZDelegate(args); } };
+    // The jobs are shared between the threads by their expected cost,
+    // and each job's time is noted to correct the costs of its channels
+    scheduleChannels(chans, DetectorBatch<Solver>::lanes, numFrames, framesToDo);
+
+    auto delegate {
+        [this, &out](void* args) {
+            const GetZ_params* job { static_cast<GetZ_params*>(args) };
+            const auto start { std::chrono::steady_clock::now() };
+            processChannels<Solver>(job, out);
+            const std::chrono::duration<double> time {
+                std::chrono::steady_clock::now() - start
+            };
+            // The cost per frame of each channel is a running average,
+            // so a job that was descheduled once isn't taken as slow
+            const double cost { time.count() / (job->numFrames * job->numChannels) };
+            for (std::size_t k {0}; k < job->numChannels; k++) {
+                double& c { channelCost[job->channels[k]] };
+                c = c > 0 ? 0.75*c + 0.25*cost : cost;
+            }
+        }
+    };
 
 #   if (DEBUG & 1)
-        std::cout << "Launching getZ manifold with " <<
-                    numThreads << " threads...";
+        std::cout << "Sharing " << jobs.size() << " getZ jobs between "
+                  << threadPool->threads << " threads...";
 #   endif
 
-    threadPool->manifold(delegate,
-                         threadArgs,
-                         numThreads);
+    threadPool->share(delegate, jobArgs.data(), jobs.size(), jobCosts.data());
 
 #   if (DEBUG & 1)
         std::cout << " finished\n";
 #   endif
 
-    for (size_t t {0} ; t < numThreads ; t++)
-        delete static_cast<GetZ_params*>(threadArgs[t]);
+    advance(framesToDo);
 
-    currentSample += framesToDo;
+    return framesOut;
+}
 
-    return framesToDo;
+void DetectorBank::advance(const std::size_t numSamples)
+{
+    if (mapped)
+        mapped->release(currentSample, numSamples);
+    currentSample += numSamples;
 }
 
-void DetectorBank::getZDelegate(void* args)
+void DetectorBank::scheduleChannels(const std::size_t chans, const std::size_t lanes,
+                                    const std::size_t framesPerChannel,
+                                    const std::size_t numFrames)
 {
-    GetZ_params* const a = static_cast<GetZ_params*>(args);
-    for ( std::size_t c {a->firstChannel} ;
-          c < a->firstChannel + a->numChannels ;
-          c++ ) {
-        discriminator_t* const target(a->frames + a->framesPerChannel*c);
-        const inputSample_t* const source(dbComponents[c].signal + currentSample);
-        detectors[c]->processAudio(target, source, a->numFrames);
+    auto before {
+        [this](std::size_t a, std::size_t b) {
+            const detector_components& ca { dbComponents[a] };
+            const detector_components& cb { dbComponents[b] };
+            if (ca.decimation != cb.decimation)
+                return ca.decimation < cb.decimation;
+            return std::less<const inputSample_t*>()(ca.signal, cb.signal);
+        }
+    };
+    // The order of the last call is kept while it's still in order
+    if (channelOrder.size() != chans ||
+        !std::is_sorted(channelOrder.begin(), channelOrder.end(), before)) {
+        channelOrder.resize(chans);
+        std::iota(channelOrder.begin(), channelOrder.end(), 0);
+        std::stable_sort(channelOrder.begin(), channelOrder.end(), before);
+    }
+
+    const std::size_t threads { threadPool->threads };
+    const std::size_t width {
+        std::min(lanes, std::max((chans + threads - 1) / threads, std::size_t(1)))
+    };
+    jobs.clear();
+    for (std::size_t i {0}, n; i < chans; i += n) {
+        const std::size_t decimation { dbComponents[channelOrder[i]].decimation };
+        for (n = 1;
+             n < width && i + n < chans &&
+             dbComponents[channelOrder[i + n]].decimation == decimation;
+             n++)
+            ;
+        jobs.push_back(GetZ_params { &channelOrder[i], n, framesPerChannel, numFrames });
     }
+    jobArgs.resize(jobs.size());
+    for (std::size_t j {0}; j < jobs.size(); j++)
+        jobArgs[j] = &jobs[j];
+
+    // Channels not yet measured are estimated from the others in
+    // proportion to the work they do: a decimated channel runs at a
+    // fraction of the rate and a shifted channel shifts its input too
+    auto estimate { [this](std::size_t c) {
+        return (dbComponents[c].hilbert ? 2. : 1.) / dbComponents[c].decimation;
+    } };
+    double measured {0}, estimated {0};
+    for (std::size_t c {0}; c < chans; c++)
+        if (channelCost[c] > 0) {
+            measured += channelCost[c];
+            estimated += estimate(c);
+        }
+    const double scale { measured > 0 ? measured / estimated : 1 };
+
+    jobCosts.assign(jobs.size(), 0);
+    for (std::size_t j {0}; j < jobs.size(); j++)
+        for (std::size_t k {0}; k < jobs[j].numChannels; k++) {
+            const std::size_t c { jobs[j].channels[k] };
+            jobCosts[j] += channelCost[c] > 0 ? channelCost[c] : scale * estimate(c);
+        }
+}
+
+template <class Solver, typename T>
+void DetectorBank::processChannels(const GetZ_params* a, const GetZ_output<T>& out)
+{
+    const std::size_t lanes { DetectorBatch<Solver>::lanes };
+    const std::size_t* channels { a->channels };
+
+    // All the detectors in a bank use the same numerical method,
+    // so they are advanced in groups by the batched solver.
+    // Detectors run at the same rate are advanced together
+    std::size_t groupSize;
+    for ( std::size_t i {0} ; i < a->numChannels ; i += groupSize ) {
+        const std::size_t decimation { dbComponents[channels[i]].decimation };
+        for (groupSize = 1;
+             groupSize < lanes && i + groupSize < a->numChannels &&
+             dbComponents[channels[i + groupSize]].decimation == decimation;
+             groupSize++)
+            ;
+        // A decimated detector steps at the samples which are multiples
+        // of its decimation factor, reading the next decimated sample
+        const std::size_t next { (currentSample + decimation - 1) / decimation };
+        const std::size_t skip { next * decimation - currentSample };
+        AbstractDetector* group[lanes];
+        const inputSample_t* sources[lanes];
+        const inputSample_t* hilberts[lanes];
+        FrequencyShift* shifts[lanes];
+        const std::size_t* c { channels + i };
+
+        for (std::size_t l {0}; l < groupSize; l++) {
+            detector_components& component { dbComponents[c[l]] };
+            group[l]    = detectors[c[l]].get();
+            sources[l]  = component.signal + next;
+            hilberts[l] = component.hilbert ? component.hilbert + next : nullptr;
+            shifts[l]   = component.hilbert ? &component.shift : nullptr;
+        }
+
+        if (out.frames) {
+            std::complex<T>* targets[lanes];
+            for (std::size_t l {0}; l < groupSize; l++)
+                targets[l] = out.frames + a->framesPerChannel*c[l];
+            DetectorBatch<Solver>::process(group, targets, sources,
+                                           groupSize, a->numFrames, out.hop,
+                                           hilberts, shifts, decimation, skip, gain);
+        } else {
+            // The channels of a group needn't be adjacent, so their
+            // maxima are gathered and scattered
+            T* targets[lanes];
+            T maxima[lanes];
+            for (std::size_t l {0}; l < groupSize; l++) {
+                targets[l] = out.absFrames + a->framesPerChannel*c[l];
+                maxima[l] = out.maxima ? out.maxima[c[l]] : 0;
+            }
+            DetectorBatch<Solver>::process(group, targets,
+                                           out.maxima ? maxima : nullptr,
+                                           sources, groupSize, a->numFrames,
+                                           out.hop, out.pooling,
+                                           hilberts, shifts, decimation, skip, gain);
+            if (out.maxima)
+                for (std::size_t l {0}; l < groupSize; l++)
+                    out.maxima[c[l]] = maxima[l];
+        }
+    }
+}
+
+template <class Solver, typename T>
+bool DetectorBank::scanChannels(const GetZ_output<T>& out, const std::size_t chans,
+                                const std::size_t framesPerChannel,
+                                const std::size_t numFrames)
+{
+    // Each channel gets an equal share of the threads, but no block
+    // is made too short to be worth the overhead of the scan.
+    const std::size_t blocks {
+        std::min(threadPool->threads / std::max(chans, std::size_t(1)),
+                 numFrames / DetectorScan<Solver>::minBlock)
+    };
+    if (blocks < 2 || out.hop > DetectorScan<Solver>::minBlock)
+        return false;
+    for (std::size_t c {0}; c < chans; c++)
+        if (!DetectorScan<Solver>::linear(detectors[c].get()) ||
+            dbComponents[c].hilbert || dbComponents[c].decimation != 1)
+            return false;
+
+    // The scans and their blocks are made in the space reserved by
+    // makeDetectors(), so no allocation depends on the length of input
+    std::vector<DetectorScan<Solver>>& scans {
+        *static_cast<std::vector<DetectorScan<Solver>>*>(this->scans.get())
+    };
+    scans.clear();
+    scanParams.clear();
+    for (std::size_t c {0}; c < chans; c++) {
+        scans.emplace_back(detectors[c].get(), dbComponents[c].signal + currentSample,
+                           numFrames, blocks, &scanStates[c*blocks], out.hop, gain);
+        for (std::size_t k {0}; k < blocks; k++)
+            scanParams.push_back(Scan_params {
+                &scans[c], k,
+                out.frames ? out.frames + framesPerChannel*c : nullptr,
+                out.absFrames ? out.absFrames + framesPerChannel*c : nullptr,
+                out.pooling, 0
+            });
+    }
+    scanArgs.clear();
+    for (Scan_params& p : scanParams)
+        scanArgs.push_back(&p);
+
+    // The final block of each channel need not be run from a zero
+    // state, so it's left out of the first pass.
+    scanFirstPass.clear();
+    for (Scan_params& p : scanParams)
+        if (p.block+1 < blocks)
+            scanFirstPass.push_back(&p);
+
+    threadPool->manifold([](void* a) {
+                             const Scan_params* p { static_cast<Scan_params*>(a) };
+                             static_cast<DetectorScan<Solver>*>(p->scan)->runBlock(p->block);
+                         },
+                         scanFirstPass.data(), scanFirstPass.size());
+
+    for (auto& scan : scans)
+        scan.propagate();
+
+    threadPool->manifold([](void* a) {
+                             Scan_params* p { static_cast<Scan_params*>(a) };
+                             DetectorScan<Solver>* scan {
+                                 static_cast<DetectorScan<Solver>*>(p->scan)
+                             };
+                             if (p->target)
+                                 scan->writeBlock(p->block, static_cast<std::complex<T>*>(p->target));
+                             else
+                                 p->mx = scan->writeAbsBlock(p->block, static_cast<T*>(p->absTarget),
+                                                             p->pooling);
+                         },
+                         scanArgs.data(), scanArgs.size());
+
+    if (out.maxima)
+        for (const Scan_params& p : scanParams) {
+            T& mx { out.maxima[(&p - scanParams.data()) / blocks] };
+            mx = std::max(mx, T(p.mx));
+        }
+
+    return true;
 }
 
 result_t DetectorBank::absZ(result_t* absFrames,
@@ -403,10 +1366,31 @@ result_t DetectorBank::absZ(result_t* absFrames,
                             discriminator_t* frames,
                             std::size_t maxThreads
                        ) const
+{
+    return absZValues(absFrames, absChans, absNumFrames, frames, maxThreads);
+}
+
+resultf_t DetectorBank::absZ(resultf_t* absFrames,
+                             std::size_t absChans,
+                             std::size_t absNumFrames,
+                             discriminatorf_t* frames,
+                             std::size_t maxThreads
+                        ) const
+{
+    return absZValues(absFrames, absChans, absNumFrames, frames, maxThreads);
+}
+
+template <typename T>
+T DetectorBank::absZValues(T* absFrames,
+                           std::size_t absChans,
+                           std::size_t absNumFrames,
+                           std::complex<T>* frames,
+                           std::size_t maxThreads
+                          ) const
 {
     auto absZDelegate =
         [absFrames, frames](void* args) {
-            const AbsZ_params* a { static_cast<AbsZ_params*>(args) };
+            const AbsZ_params<T>* a { static_cast<AbsZ_params<T>*>(args) };
             for (std::size_t i{a->start}; i < a->end; i++)
                a->mx = std::max((absFrames[i] = std::abs(frames[i])), a->mx);
         };
@@ -427,14 +1411,14 @@ result_t DetectorBank::absZ(result_t* absFrames,
 
     };
     void* threadArgs[numThreads];
-    result_t maxVals[numThreads] = { }; // Initially 0
+    T maxVals[numThreads] = { }; // Initially 0
 
     for (std::size_t t{0}; t < numThreads; t++)
-        threadArgs[t] = new AbsZ_params { t*dataPoints/numThreads,
-                                          (t+1)*dataPoints/numThreads,
-                                          std::ref(maxVals[t]) };
+        threadArgs[t] = new AbsZ_params<T> { t*dataPoints/numThreads,
+                                             (t+1)*dataPoints/numThreads,
+                                             std::ref(maxVals[t]) };
 
-    result_t overallMax { 0.0 };
+    T overallMax { 0.0 };
 
 #   if (DEBUG & 1)
         std::cout << "Launching absZ manifold with "
@@ -449,19 +1433,30 @@ result_t DetectorBank::absZ(result_t* absFrames,
         
     for (std::size_t th{0}; th < numThreads; th++) {
         overallMax = std::max(overallMax, maxVals[th]);
-        delete static_cast<AbsZ_params*>(threadArgs[th]);
+        delete static_cast<AbsZ_params<T>*>(threadArgs[th]);
     }
 
     return overallMax;
 }
 
+void DetectorBank::setNormalisationCache(const std::string& path)
+{
+    NormalisationCache::instance().setPath(path);
+}
+
 const std::map<int, std::string> DetectorBank::featuresToStringMap {
         {{central_difference}, {"Central difference method"}},
         {{runge_kutta},        {"Runge-Kutta method"}},
+        {{exact_linear},       {"Exact linear method"}},
+        {{semi_implicit},      {"Semi-implicit method"}},
         {{freq_unnormalized},  {"Frequency unnormalized"}},
         {{search_normalized},  {"Search-normalized"}},
         {{amp_unnormalized},   {"Amplitude unnormalized"}},
-        {{amp_normalized},     {"Amplitude normalized"}}
+        {{amp_normalized},     {"Amplitude normalized"}},
+        {{deferred_normalization}, {"Deferred normalization"}},
+        {{shift_on_the_fly},   {"Frequency shift on the fly"}},
+        {{multirate},          {"Multirate"}},
+        {{realtime},           {"Realtime"}}
 };
 
 void DetectorBank::stringToFeatures(const std::string& desc) {
@@ -519,7 +1514,18 @@ const std::string DetectorBank::featuresToString(void) const {
         ampNormalizationName = "[Unknown amplitude normalization method]";
     }
 
-    return  solverName + "," + freqNormalizationName + "," + ampNormalizationName;
+    std::string description {
+        solverName + "," + freqNormalizationName + "," + ampNormalizationName
+    };
+    if (features & Features::deferred_normalization)
+        description += "," + featuresToStringMap.at(Features::deferred_normalization);
+    if (features & Features::shift_on_the_fly)
+        description += "," + featuresToStringMap.at(Features::shift_on_the_fly);
+    if (features & Features::multirate)
+        description += "," + featuresToStringMap.at(Features::multirate);
+    if (features & Features::realtime)
+        description += "," + featuresToStringMap.at(Features::realtime);
+    return description;
 };
 
 
@@ -587,40 +1593,55 @@ template<class Archive> void DetectorBank::load(Archive& archive)
     std::string featureSet;
     size_t threads;
     archive(sr, d, threads, featureSet, gain);
-    threadPool = std::unique_ptr<ThreadPool>(new ThreadPool(threads));
+    // A profile's input is taken to be at its operating rate
+    inputRate = sr;
+    resampler.reset();
+    stopNormalisation();
     stringToFeatures(featureSet);
+    threadPool = std::unique_ptr<ThreadPool>(
+        new ThreadPool(threads, features & Features::realtime));
 
     cereal::size_type numDetectors;
     archive(numDetectors);
 
-
-    // Create the right sort of detectors,
-    // then restore their state later.
-    dbComponents.clear();
-    detectors.clear();
-//     std::cout << "I'm going to load " << numDetectors << " detectors\n";
-    makeDetectors(numDetectors, 0, d, sr, features, gain);
-    std::cout << "There are now " << detectors.size() << " detector(s)\n";
-
-    // Reload all of the working parameters for each detector
+    // Read the working parameters of each detector first, as the
+    // detectors can only be made at their proper rates (see multirate)
+    // once the dbComponents vector has been rebuilt from the raw
+    // frequencies and bandwidths
     archive.setNextName("Detectors");
     archive.startNode();
-    parameter_t freqs[numDetectors];
-    parameter_t bw [numDetectors];
+    std::vector<parameter_t> freqs(numDetectors);
+    std::vector<parameter_t> bw(numDetectors);
+    std::vector<NormalisationCache::Value> normalisations(numDetectors);
     for (cereal::size_type i{0}; i<numDetectors; i++) {
         archive.setNextName("Detector");
         archive.startNode();
         archive(cereal::make_nvp("w_in", freqs[i]));
         freqs[i] /= 2.0*M_PI;
         archive(cereal::make_nvp("bw", bw[i]));
-        detectors[i]->load(archive);
+        normalisations[i] = AbstractDetector::loadNormalisation(archive);
         archive.finishNode();
     }
     archive.finishNode();
 
-    // We're going to have to rebuild the dbComponents vector
-    // from the raw frequencies and bandwdiths now.
-    setDBComponents(freqs, bw, numDetectors);
+    dbComponents.clear();
+    detectors.clear();
+    setDBComponents(freqs.data(), bw.data(), numDetectors);
+
+    // Create the right sort of detectors unnormalised,
+    // then restore their saved normalisation.
+//     std::cout << "I'm going to load " << numDetectors << " detectors\n";
+    const Features unnormalized {
+        static_cast<Features>((features & solverMask) | Features::freq_unnormalized |
+                              Features::amp_unnormalized)
+    };
+    makeDetectors(numDetectors, 0, d, sr, unnormalized, gain);
+    std::cout << "There are now " << detectors.size() << " detector(s)\n";
+    const bool searched {
+        (features & freqNormalizationMask) == Features::search_normalized
+    };
+    for (cereal::size_type i{0}; i<numDetectors; i++)
+        detectors[i]->setNormalisation(normalisations[i], searched);
 }
 
 bool DetectorBank::seek(long int offset) {
@@ -639,8 +1660,18 @@ bool DetectorBank::seek(long int offset) {
     if (offset == 0) {
         for (std::size_t i {0}; i < detectors.size(); i++)
             detectors[i]->reset();
+        if (stream.shifter)
+            stream.shifter->reset();
+        if (resampler)
+            resampler->reset();
     }
 
+    // Inputs shifted on the fly continue from the phase at the new position
+    if (result)
+        for (detector_components& component : dbComponents)
+            if (component.hilbert)
+                component.shift.seek(currentSample);
+
     return result;
 }
 
@@ -656,6 +1687,25 @@ parameter_t DetectorBank::getFreqIn(std::size_t ch) const {
         : dbComponents[ch].f_in;
 }
 
+std::size_t DetectorBank::getDecimation(std::size_t ch) const {
+    return (ch >= dbComponents.size()) ? 0 : dbComponents[ch].decimation;
+}
+
+parameter_t DetectorBank::getStepRate(void) const {
+    parameter_t rate {0};
+    for (const detector_components& component : dbComponents)
+        rate += sr / component.decimation;
+    return rate;
+}
+
+std::size_t DetectorBank::decimationFor(const parameter_t f,
+                                        const parameter_t bandwidth) const {
+    std::size_t decimation {1};
+    while (decimation < maxDecimation && 2 * decimation * (f + bandwidth) <= modF)
+        decimation *= 2;
+    return decimation;
+}
+
 
 
 ProfileManager DetectorBank::profileManager;
@@ -5,6 +5,7 @@
 /*! Bank of note onset detectors, each operating at a given frequency.
  */
 #include <complex>
+#include <cstdint>
 #include <utility>
 #include <memory>
 #include <vector>
@@ -14,9 +15,15 @@
 #include <mutex>
 #include <list>
 #include <condition_variable>
+#include <atomic>
+#include <functional>
 #include <cereal/access.hpp>
 
 #include "detectortypes.h"
+#include "frequencyshifter.h"
+#include "mappedinput.h"
+#include "resampler.h"
+#include "normalisationcache.h"
 #include "thread_pool.h"
 
 class AbstractDetector;
@@ -32,6 +39,9 @@ public:
     static constexpr int freqNormalizationMask { 0xff << 8 };
     /*! Bit mask for specifying the amplitude normalisation method */
     static constexpr int ampNormalizationMask { 0xff << 16 };
+    /*! Bit mask for specifying when normalisation is performed and
+     *  the rates at which the detectors are run on their input */
+    static constexpr int normalizationTimingMask { 0xff << 24 };
     /*! Specify numerical and normalisation methods for this detector bank. 
      *  Please see \link FeaturesExplained DetectorBank Features\endlink for more information.
      */
@@ -40,6 +50,8 @@ public:
         // Choose numerical method
         central_difference = 1,        /*!< Central-difference */
         runge_kutta        = 2,        /*!< Fourth order Runge-Kutta */
+        exact_linear       = 4,        /*!< Exact discretisation (minimum bandwidth only) */
+        semi_implicit      = 8,        /*!< Second order semi-implicit */
         
         // Frequency normalisation
         freq_unnormalized  = 1 << 8,   /*!< Without frequency normalisation */
@@ -49,6 +61,18 @@ public:
         amp_unnormalized   = 1 << 16,  /*!< Without amplitude normalisation */
         amp_normalized     = 2 << 16,  /*!< Scale real and imaginary parts of the response */
         
+        // Normalisation timing
+        deferred_normalization = 1 << 24, /*!< Normalise in the background, after construction */
+        
+        // Frequency shifting
+        shift_on_the_fly   = 2 << 24,  /*!< Shift the input as the detectors read it */
+        
+        // Sample rate
+        multirate          = 4 << 24,  /*!< Run low-frequency detectors on decimated input */
+        
+        // Dispatch
+        realtime           = 8 << 24,  /*!< Low-latency threads for small blocks of getZ */
+        
         // Vanilla
         //! Default is Runge-Kutta, unnormalised frequency, normalised amplitude
         defaults            = runge_kutta | freq_unnormalized | amp_normalized
@@ -58,7 +82,9 @@ public:
     /*! Mask which selects possible numerical methods */
     static constexpr int method_mask {
         Features::central_difference |
-        Features::runge_kutta
+        Features::runge_kutta        |
+        Features::exact_linear       |
+        Features::semi_implicit
     };
 
     /*! Mask which selects possible frequency normalizations */    
@@ -72,6 +98,12 @@ public:
         Features::amp_unnormalized |
         Features::amp_normalized
     };
+
+    /*! How getPooledZ() reduces each hop of magnitudes to one frame */
+    enum Pooling {
+        max_abs,                       /*!< Largest \f$|z|\f$ in the hop */
+        mean_power                     /*!< Mean of \f$|z|^2\f$ over the hop */
+    };
     
     /*!
      * Construct a DetectorBank from archived parameters
@@ -86,28 +118,32 @@ public:
 
     /*!
      * Construct a DetectorBank.
-     * \param sr Sample rate of audio. (This must be 44100 or 48000.)
+     * \param sr Sample rate of audio. The detectors are run at 44100 or
+     * 48000, and audio at any other rate is resampled to whichever of these
+     * it is related to by the simpler ratio (see getSR()).
      * \param inputBuffer Audio input
      * \param inputBufferSize Length of audio input
      * \param numThreads Number of threads to execute concurrently
-     * to determine the detector outputs. Passing a value of less than
+     * to normalise the detectors and determine their outputs. Passing a value of less than
      * 1 causes the number of threads to be set according to the number
      * of reported CPU cores
      * \param freqs Array of frequencies for the detector bank
      * \param bw Array of bandwidths for each detector. If nullptr, minimum 
      * bandwidth detectors will be constructed
      * \param numDetectors Length of the freqs and bandwidths arrays
-     * \param features Numerical method (runge_kutta or central_difference),
-     * frequency normalisation (freq_unnormalized or search_normalized) and
-     * amplitude normalisation (amp_unnormalized or amp_normalized).
+     * \param features Numerical method (runge_kutta, central_difference,
+     * exact_linear or semi_implicit), frequency normalisation (freq_unnormalized or search_normalized) and
+     * amplitude normalisation (amp_unnormalized or amp_normalized),
+     * optionally with deferred_normalization.
      * Default is runge_kutta|freq_unnormalized|amp_normalized.
      * See \link FeaturesExplained DetectorBank Features\endlink for more information.
      * \param damping Damping for all detectors
      * \param gain Audio input gain to be applied. (Default value of 25
      * is recommended in order to keep the numbers used in the internal
      * calculations within a sensible range.)
-     * \throw std::string Sample rate should be 44100 or 48000
+     * \throw std::invalid_argument Sample rates should be positive.
      * \throw std::string Central difference can only be used for minimum bandwidth detectors.
+     * \throw std::string Exact linear method can only be used for minimum bandwidth detectors.
      */
     DetectorBank(const parameter_t sr,
                  const inputSample_t* inputBuffer,
@@ -120,6 +156,99 @@ public:
                  parameter_t damping = 0.0001,
                  const parameter_t gain = 25.0);
 
+    /*!
+     * Construct a DetectorBank whose input is read from a file, which is
+     * mapped into memory rather than read (see MappedInput).
+     * Mono 32-bit floating point samples are read from the file as the
+     * detectors need them, and pages of the file the detectors have
+     * finished with are dropped from memory, so a recording need not fit
+     * in memory. Other WAV files are converted as they are opened.
+     * \param path Path of a WAV file (16, 24 or 32-bit PCM or 32-bit
+     * floating point) or of a file of raw float32 samples
+     * \param numThreads As for the constructor from an input buffer
+     * \param freqs As for the constructor from an input buffer
+     * \param bw As for the constructor from an input buffer
+     * \param numDetectors As for the constructor from an input buffer
+     * \param features As for the constructor from an input buffer
+     * \param damping As for the constructor from an input buffer
+     * \param gain As for the constructor from an input buffer
+     * \param sr Sample rate of a raw file. That of a WAV file is read
+     * from the file.
+     * \throw std::runtime_error The file can't be opened or mapped.
+     * \throw std::invalid_argument The file's format isn't supported,
+     * or no sample rate is given for a raw file.
+     */
+    DetectorBank(const std::string& path,
+                 std::size_t numThreads,
+                 const parameter_t* freqs = EDO12_pf,
+                 parameter_t* bw = nullptr,
+                 const std::size_t numDetectors = EDO12_pf_size,
+                 Features features = Features::defaults,
+                 parameter_t damping = 0.0001,
+                 const parameter_t gain = 25.0,
+                 const parameter_t sr = 0);
+
+    /*!
+     * Construct a DetectorBank from interleaved 16-bit PCM audio of one
+     * or more channels, which is converted to mono floating point as by
+     * setInputBuffer(const std::int16_t*, const std::size_t, const std::size_t).
+     * \param sr As for the constructor from a floating point buffer
+     * \param inputBuffer Audio input
+     * \param numFrames Number of frames of audio input
+     * \param numChannels Number of channels of audio input
+     * \param numThreads As for the constructor from a floating point buffer
+     * \param freqs As for the constructor from a floating point buffer
+     * \param bw As for the constructor from a floating point buffer
+     * \param numDetectors As for the constructor from a floating point buffer
+     * \param features As for the constructor from a floating point buffer
+     * \param damping As for the constructor from a floating point buffer
+     * \param gain As for the constructor from a floating point buffer
+     */
+    DetectorBank(const parameter_t sr,
+                 const std::int16_t* inputBuffer,
+                 const std::size_t numFrames,
+                 const std::size_t numChannels,
+                 std::size_t numThreads,
+                 const parameter_t* freqs = EDO12_pf,
+                 parameter_t* bw = nullptr,
+                 const std::size_t numDetectors = EDO12_pf_size,
+                 Features features = Features::defaults,
+                 parameter_t damping = 0.0001,
+                 const parameter_t gain = 25.0);
+
+    /*!
+     * Construct a DetectorBank from interleaved 24 or 32-bit PCM audio
+     * of one or more channels held in 32-bit integers, which is converted
+     * to mono floating point as by
+     * setInputBuffer(const std::int32_t*, const std::size_t, const std::size_t, const unsigned).
+     * \param sr As for the constructor from a floating point buffer
+     * \param inputBuffer Audio input
+     * \param numFrames Number of frames of audio input
+     * \param numChannels Number of channels of audio input
+     * \param bits 32, or 24 for 24-bit samples in the low 24 bits of
+     * each integer
+     * \param numThreads As for the constructor from a floating point buffer
+     * \param freqs As for the constructor from a floating point buffer
+     * \param bw As for the constructor from a floating point buffer
+     * \param numDetectors As for the constructor from a floating point buffer
+     * \param features As for the constructor from a floating point buffer
+     * \param damping As for the constructor from a floating point buffer
+     * \param gain As for the constructor from a floating point buffer
+     * \throw std::invalid_argument PCM samples should have 24 or 32 bits.
+     */
+    DetectorBank(const parameter_t sr,
+                 const std::int32_t* inputBuffer,
+                 const std::size_t numFrames,
+                 const std::size_t numChannels,
+                 const unsigned bits,
+                 std::size_t numThreads,
+                 const parameter_t* freqs = EDO12_pf,
+                 parameter_t* bw = nullptr,
+                 const std::size_t numDetectors = EDO12_pf_size,
+                 Features features = Features::defaults,
+                 parameter_t damping = 0.0001,
+                 const parameter_t gain = 25.0);
+
     virtual ~DetectorBank();
     
     // Maybe want to reuse the object on a different input buffer
@@ -130,6 +259,89 @@ public:
      */
     void setInputBuffer(const inputSample_t* inputBuffer,
                         const std::size_t inputBufferSize);
+    /*!
+     * Change the input to interleaved floating point audio of one or
+     * more channels, whose channels are averaged (see PCMConverter).
+     * The mono input is a copy kept by the DetectorBank.
+     * \param inputBuffer New input samples
+     * \param numFrames Number of frames of new input
+     * \param numChannels Number of channels of new input
+     */
+    void setInputBuffer(const inputSample_t* inputBuffer,
+                        const std::size_t numFrames,
+                        const std::size_t numChannels);
+    /*!
+     * Change the input to interleaved 16-bit PCM audio of one or more
+     * channels, which is scaled to lie in [-1, 1) and whose channels are
+     * averaged in a single pass (see PCMConverter).
+     * The mono input is a copy kept by the DetectorBank.
+     * \param inputBuffer New input samples
+     * \param numFrames Number of frames of new input
+     * \param numChannels Number of channels of new input
+     */
+    void setInputBuffer(const std::int16_t* inputBuffer,
+                        const std::size_t numFrames,
+                        const std::size_t numChannels);
+    /*!
+     * Change the input to interleaved 24 or 32-bit PCM audio of one or
+     * more channels held in 32-bit integers, as for 16-bit audio.
+     * \param inputBuffer New input samples
+     * \param numFrames Number of frames of new input
+     * \param numChannels Number of channels of new input
+     * \param bits 32, or 24 for 24-bit samples in the low 24 bits of
+     * each integer
+     * \throw std::invalid_argument PCM samples should have 24 or 32 bits.
+     */
+    void setInputBuffer(const std::int32_t* inputBuffer,
+                        const std::size_t numFrames,
+                        const std::size_t numChannels,
+                        const unsigned bits = 32);
+    /*!
+     * Run the detectors on the next block of a stream of input, such as
+     * live audio, in place of an input buffer.
+     *
+     * Each block continues the signal of the last: the detectors' states,
+     * the Hilbert transform used to frequency shift the input and the
+     * phases of the shifts are carried from one block to the next, so the
+     * output is exactly that which getZ() would give for the blocks as
+     * one buffer. If any channel is frequency shifted, the output lags
+     * the input by getLatency() frames, and the last frames are written
+     * by flush(). Memory is only allocated for a block which is longer
+     * than any before it.
+     *
+     * The stream replaces the input buffer, so getZ() returns nothing
+     * until setInputBuffer() is called. setInputBuffer() or seek(0) starts
+     * a new stream.
+     * \param input Block of input samples
+     * \param numSamples Length of the block
+     * \param frames Output array of getChans() channels of
+     *        getBlockFrames(numSamples) frames
+     * \return Number of frames written to each channel
+     * \throw std::runtime_error if the bank has the multirate feature
+     */
+    int process(const inputSample_t* input, const std::size_t numSamples,
+                discriminator_t* frames);
+    /*!
+     * End the stream fed to process(), writing the frames still to come.
+     * The detectors' states are kept, as by getZ() at the end of the
+     * input; seek(0) resets them.
+     * \param frames Output array of getChans() channels of getLatency() frames
+     * \return Number of frames written to each channel
+     */
+    int flush(discriminator_t* frames);
+    /*! Find the number of frames by which the output of process() lags
+     *  its input
+     * \return The latency (frames), which is 0 if no channel is
+     *         frequency shifted and the input isn't resampled
+     */
+    std::size_t getLatency(void) const;
+    /*! Find the number of frames per channel of the output array of
+     *  process() for a block of input, which is the length of the block
+     *  unless the input is resampled
+     * \param numSamples Length of the block
+     * \return Largest number of frames written to each channel
+     */
+    std::size_t getBlockFrames(const std::size_t numSamples) const;
     // Get some frames of z-values from the discriminators
     // Repeated calls progressively traverse the audio input buffer.
     // Returns the number of frames actually processed
@@ -144,6 +356,134 @@ public:
     int getZ(discriminator_t* frames,
              std::size_t chans, std::size_t numFrames,
              const std::size_t startChan = 0);
+    /*! Get the next numFrames of detector bank output, advancing the
+     * detectors in single precision.
+     * 
+     * The detector states are held in double precision between calls,
+     * but all of the per-sample arithmetic is performed in float, which
+     * halves the memory bandwidth required for the output and doubles
+     * the number of detectors advanced per vector instruction. The
+     * results are accurate to about 1e-3 of full scale for
+     * minimum-bandwidth detectors; detectors with a wide bandwidth
+     * may require double precision.
+     * \param frames Output array
+     * \param chans Height of output array
+     * \param numFrames Length of output array
+     * \param startChan Channel from which to start
+     * \return Number of frames processed
+     */
+    int getZ(discriminatorf_t* frames,
+             std::size_t chans, std::size_t numFrames,
+             const std::size_t startChan = 0);
+    /*! Get the magnitudes of the next numFrames of detector bank output.
+     *
+     * Equivalent to getZ() followed by absZ(), but the detectors write
+     * \f$|z|\f$ directly, so no complex intermediate array is required
+     * and the output is made in a single pass.
+     * \param absFrames Output array
+     * \param absChans Height of output array
+     * \param absNumFrames Length of output array
+     * \param startChan Channel from which to start
+     * \param maxima If not null, an array of absChans values, each of
+     *        which is raised to the largest magnitude written to the
+     *        corresponding channel. Setting these to zero before the
+     *        first call gives a running maximum for each channel.
+     * \return Number of frames processed
+     */
+    int getAbsZ(result_t* absFrames,
+                std::size_t absChans, std::size_t absNumFrames,
+                const std::size_t startChan = 0,
+                result_t* maxima = nullptr);
+    /*! Single-precision version of getAbsZ(); the detectors are
+     * advanced in single precision as by the single-precision getZ().
+     * \param absFrames Output array
+     * \param absChans Height of output array
+     * \param absNumFrames Length of output array
+     * \param startChan Channel from which to start
+     * \param maxima If not null, running maximum of each channel
+     * \return Number of frames processed
+     */
+    int getAbsZ(resultf_t* absFrames,
+                std::size_t absChans, std::size_t absNumFrames,
+                const std::size_t startChan = 0,
+                resultf_t* maxima = nullptr);
+    /*! Get every hop'th frame of the next numFrames*hop frames of
+     * detector bank output.
+     *
+     * The detectors are advanced at the full sample rate, but only the
+     * first output of each hop is written, so the output array and the
+     * memory traffic are reduced by a factor of hop. Frames are counted
+     * from the current input sample, so to keep the output on a regular
+     * grid across calls each call should end on a whole hop.
+     * \param frames Output array
+     * \param chans Height of output array
+     * \param numFrames Length of output array
+     * \param hop Number of input samples per output frame
+     * \param startChan Channel from which to start
+     * \return Number of output frames written. This is less than
+     *         numFrames at the end of the input, and the last frame may
+     *         then represent part of a hop.
+     */
+    int getDecimatedZ(discriminator_t* frames,
+                      std::size_t chans, std::size_t numFrames,
+                      const std::size_t hop,
+                      const std::size_t startChan = 0);
+    /*! Single-precision version of getDecimatedZ().
+     * \param frames Output array
+     * \param chans Height of output array
+     * \param numFrames Length of output array
+     * \param hop Number of input samples per output frame
+     * \param startChan Channel from which to start
+     * \return Number of output frames written
+     */
+    int getDecimatedZ(discriminatorf_t* frames,
+                      std::size_t chans, std::size_t numFrames,
+                      const std::size_t hop,
+                      const std::size_t startChan = 0);
+    /*! Get the next numFrames*hop frames of detector bank output as
+     * magnitudes pooled over each hop.
+     *
+     * Each output frame is the largest \f$|z|\f$ or the mean of
+     * \f$|z|^2\f$ over hop consecutive samples, found as the detectors
+     * run, so that the output array and the memory traffic are reduced
+     * by a factor of hop. getAbsZ() is equivalent to max_abs pooling
+     * with a hop of 1. As for getDecimatedZ(), hops are counted from
+     * the current input sample.
+     * \param absFrames Output array
+     * \param absChans Height of output array
+     * \param absNumFrames Length of output array
+     * \param hop Number of input samples per output frame
+     * \param pooling How each hop is reduced to a frame
+     * \param startChan Channel from which to start
+     * \param maxima If not null, an array of absChans values, each of
+     *        which is raised to the largest frame written to the
+     *        corresponding channel
+     * \return Number of output frames written. This is less than
+     *         absNumFrames at the end of the input, and the last frame
+     *         may then be pooled over part of a hop.
+     */
+    int getPooledZ(result_t* absFrames,
+                   std::size_t absChans, std::size_t absNumFrames,
+                   const std::size_t hop,
+                   const Pooling pooling,
+                   const std::size_t startChan = 0,
+                   result_t* maxima = nullptr);
+    /*! Single-precision version of getPooledZ().
+     * \param absFrames Output array
+     * \param absChans Height of output array
+     * \param absNumFrames Length of output array
+     * \param hop Number of input samples per output frame
+     * \param pooling How each hop is reduced to a frame
+     * \param startChan Channel from which to start
+     * \param maxima If not null, running maximum of each channel
+     * \return Number of output frames written
+     */
+    int getPooledZ(resultf_t* absFrames,
+                   std::size_t absChans, std::size_t absNumFrames,
+                   const std::size_t hop,
+                   const Pooling pooling,
+                   const std::size_t startChan = 0,
+                   resultf_t* maxima = nullptr);
     /*! Take z-frames and fill a given array of the same dimensions (absFrames) with 
      *  their absolute values.
      *  Also returns the maximum value in absFrames.
@@ -164,6 +504,57 @@ public:
                   discriminator_t* frames,
                   std::size_t maxThreads = 0
                  ) const;
+    /*! Single-precision version of absZ().
+     *  \param absFrames Output array
+     *  \param absChans Height of the output array
+     *  \param absNumFrames Length of the input array
+     *  \param frames Input array of complex z values
+     *  \param maxThreads The number of threads used to perform the calculations.
+     *  \return The maximum value found while performing the conversion
+     */
+    resultf_t absZ(resultf_t* absFrames,
+                   std::size_t absChans,
+                   const std::size_t absNumFrames,
+                   discriminatorf_t* frames,
+                   std::size_t maxThreads = 0
+                  ) const;
+    /*! Choose where the results of normalising detectors are kept
+     *  between processes (see NormalisationCache). Results already
+     *  held in memory are discarded.
+     * \param path Path of the cache file, or an empty string to keep
+     *        results only for the life of the process
+     */
+    static void setNormalisationCache(const std::string& path);
+    /*! Find how many detectors' normalisations have been found.
+     *  With deferred_normalization, normalisation continues in the
+     *  background after construction, and each result is applied at
+     *  the start of the next call to getZ() or its variants, so a
+     *  call always runs with one set of coefficients.
+     * \return Number of detectors whose normalisation has been found,
+     *         or 0 if normalisation isn't deferred
+     */
+    std::size_t getNormalisationProgress(void) const { return normalisationsFound; };
+    /*! Find whether every detector is running with its normalisation,
+     *  which is always so unless deferred_normalization is used.
+     * \return `true` once every deferred normalisation has been applied
+     */
+    bool isNormalised(void) const;
+    /*! Wait for deferred normalisation to finish and apply the results
+     *  at once, without waiting for the next call to getZ().
+     */
+    void waitForNormalisation(void);
+    /*! Set a function to be told of the progress of deferred
+     *  normalisation. It is called, on a background thread, with the
+     *  number of detectors normalised so far and the number to be
+     *  normalised each time a detector's normalisation is found, and
+     *  at once with the progress so far, so the completion of
+     *  normalisation can't be missed. It may be called more than once
+     *  with the same progress, and must not call
+     *  setNormalisationCallback().
+     * \param callback Function of the number of detectors normalised
+     *        and the total, or an empty function to stop reporting
+     */
+    void setNormalisationCallback(std::function<void(std::size_t, std::size_t)> callback);
     /*! Set input sample at which to start the detection.
      *  Negative values seek from the end of the current input buffer
      * \param offset New sample index
@@ -177,10 +568,16 @@ public:
      * \return Current input sample index
      */
     std::size_t tell(void) const { return currentSample; };
-    /*! Get the sample rate associated with this DetectorBank
+    /*! Get the sample rate at which the detectors are run, and so at
+     *  which frames are output
      * \return The current sample rate
      */
     parameter_t getSR(void) const { return sr; };
+    /*! Get the sample rate of the input, which is resampled to getSR()
+     *  if they differ
+     * \return The sample rate of the input
+     */
+    parameter_t getInputSR(void) const { return inputRate; };
     /*! Return the number of detectors currently maintained by this DetectorBank
      * \return The number of detectors
      */
@@ -205,6 +602,22 @@ public:
      * \return f_in for the specified channel
      */
     parameter_t getFreqIn(std::size_t ch) const;
+    
+    /*! Find the factor by which the input of a given channel's
+     *  \link AbstractDetector detector\endlink is decimated, which is
+     *  1 unless the bank has the multirate feature.
+     *  Returns 0 if the channel number is invalid.
+     * \param ch Channel number
+     * \return Ratio of the sample rate to that of the detector
+     */
+    std::size_t getDecimation(std::size_t ch) const;
+    
+    /*! Find the number of detector steps taken per second of input,
+     *  which without the multirate feature is the sample rate times
+     *  the number of channels
+     * \return Steps per second, summed over the channels
+     */
+    parameter_t getStepRate(void) const;
         
     /*! Return description of the detectorbank serialised in XML form */
     std::string toXML(void) const;
@@ -232,44 +645,193 @@ public:
      * \param archive The archive from which properties should be read */
     template<class Archive> void load(Archive& archive);
 
+    /*! Detectors normalise themselves with banks of their own kind,
+     *  run at their own sample rate */
+    friend class AbstractDetector;
+
 protected:    
-    /*! Apply a gain to the inputBuffer
-     * \param signal Signal to be amplified
-     * \param signalSize Size of signal
-     * \param gain Gain to be applied
+    /*!
+     * Construct a DetectorBank which runs its detectors at a given rate,
+     * resampling the input to it if the input is at another rate.
+     * Detectors run at a decimated rate (see Features::multirate) are
+     * normalised by banks run at that rate.
+     * \param inputRate Sample rate of audio
+     * \param sr Sample rate at which the detectors are run
+     * Other parameters as for the public constructor.
      */
-    void amplify(const inputSample_t*& signal,
-                 std::size_t signalSize,
+    DetectorBank(const parameter_t inputRate,
+                 const parameter_t sr,
+                 const inputSample_t* inputBuffer,
+                 const std::size_t inputBufferSize,
+                 std::size_t numThreads,
+                 const parameter_t* freqs,
+                 parameter_t* bw,
+                 const std::size_t numDetectors,
+                 Features features,
+                 parameter_t damping,
                  const parameter_t gain);
+    /*! Resample the input buffer to the operating sample rate, if it
+     *  is at another rate */
+    void prepareInput(void);
+    /*! Choose the rate at which detectors are run for input at a given
+     *  rate: 48000 or 44100, whichever is related to it by the ratio
+     *  of smaller whole numbers, so the resampling filter has fewest phases
+     * \param inputRate Sample rate of the input
+     * \return Operating sample rate */
+    static parameter_t operatingRate(const parameter_t inputRate);
     
     void worker(int id);
     
     /*!
-     * Struct to pass getZ thread parameters to a worker thread.
+     * Struct to pass a job of getZ channels to a worker thread.
      */
     typedef struct {
-        std::size_t firstChannel;     /*!< First channel to process */
+        const std::size_t* channels;  /*!< Channels to process */
 	std::size_t numChannels;      /*!< Number of channels to process */
-        discriminator_t* frames;      /*!< Output array */
-        std::size_t framesPerChannel; /*!< Number of frames per channel */
-        std::size_t numFrames;        /*!< Number of frames left to process */
+        std::size_t framesPerChannel; /*!< Number of output frames per channel */
+        std::size_t numFrames;        /*!< Number of input frames to process */
     } GetZ_params;
     
     /*!
-     * Perform one thread's worth of work on the given channels.
-     * Called by getZ().
-     * Parameters are required as a pointer to a GetZ_params.
-     * \param args Arguments
+     * Where runDetectors() is to write its output. Exactly one of
+     * frames and absFrames is set.
      */
-    void getZDelegate(void* args);
+    template <typename T>
+    struct GetZ_output {
+        std::complex<T>* frames;  /*!< Complex output, or null */
+        T* absFrames;             /*!< Magnitude output, or null */
+        T* maxima;                /*!< Per-channel running maxima of
+                                       absFrames, or null */
+        std::size_t hop;          /*!< Input samples per output frame */
+        Pooling pooling;          /*!< Reduction of each hop of absFrames */
+    };
+
+    /*!
+     * Divide the channels among the threads and run the detectors.
+     * Called by getZ(), getAbsZ(), getDecimatedZ() and getPooledZ(),
+     * through runDetectorsDouble and runDetectorsSingle; parameters are
+     * as for getZ() except that numFrames counts output frames.
+     * \tparam Solver The class of this bank's detectors
+     * \tparam T Output precision
+     */
+    template <class Solver, typename T>
+    int runDetectors(const GetZ_output<T>& out,
+                     std::size_t chans, std::size_t numFrames,
+                     const std::size_t startChan);
+
+    /*! runDetectors() specialised for the numerical method of this bank,
+     *  writing double-precision output. Set by selectSolver(). */
+    int (DetectorBank::*runDetectorsDouble)(const GetZ_output<double>&,
+                                            std::size_t, std::size_t,
+                                            const std::size_t);
+    /*! runDetectors() specialised for the numerical method of this bank,
+     *  writing single-precision output. Set by selectSolver(). */
+    int (DetectorBank::*runDetectorsSingle)(const GetZ_output<float>&,
+                                            std::size_t, std::size_t,
+                                            const std::size_t);
+    /*! Point runDetectorsDouble and runDetectorsSingle at the versions
+     *  of runDetectors() for the given class of detector, and make room
+     *  for scanChannels() to scan detectors of that class.
+     *  Called by makeDetectors(). */
+    template <class Solver>
+    void selectSolver();
+
+    /*!
+     * Divide channels into jobs for runDetectors(), and find the cost of
+     * each job from the measured costs of its channels (see channelCost).
+     * Channels run at the same rate which read the same signal are put
+     * together, in jobs of up to a batch's width, but a small bank is
+     * divided into at least as many jobs as there are threads.
+     * \param chans Number of channels to process
+     * \param lanes Width of a batch of the bank's detectors
+     * \param framesPerChannel Length of each channel in output frames
+     * \param numFrames Number of input frames to process
+     */
+    void scheduleChannels(const std::size_t chans, const std::size_t lanes,
+                          const std::size_t framesPerChannel,
+                          const std::size_t numFrames);
+    /*! Channels in the order in which they're given to jobs */
+    std::vector<std::size_t> channelOrder;
+    /*! The jobs made by scheduleChannels() */
+    std::vector<GetZ_params> jobs;
+    /*! Pointers to each of the jobs, passed to the thread pool */
+    std::vector<void*> jobArgs;
+    /*! The expected cost of each job */
+    std::vector<double> jobCosts;
+    /*!
+     * Time taken to process an input frame in each channel, in seconds,
+     * averaged over recent calls to getZ, or 0 if not yet measured
+     */
+    std::vector<double> channelCost;
+
+    /*!
+     * Advance the detectors in the channels given by the parameter block
+     * in groups, writing to the given output array.
+     * One job's worth of work, run by runDetectors().
+     * \param a Parameter block from runDetectors()
+     * \param out Output arrays (double or single precision)
+     */
+    template <class Solver, typename T>
+    void processChannels(const GetZ_params* a, const GetZ_output<T>& out);
+
+    /*!
+     * Run a bank of linear detectors which has fewer channels than there
+     * are threads by dividing the time range of each channel between
+     * the threads (see DetectorScan). Called by runDetectors().
+     * \param out Output arrays
+     * \param chans Number of channels to process
+     * \param framesPerChannel Length of each channel in output frames
+     * \param numFrames Number of input frames to process
+     * \return true if the channels were processed, false if the bank is
+     *         unsuitable and the channels must be run by processChannels()
+     */
+    template <class Solver, typename T>
+    bool scanChannels(const GetZ_output<T>& out, const std::size_t chans,
+                      const std::size_t framesPerChannel,
+                      const std::size_t numFrames);
+
+    /*!
+     * Struct to pass one block of a channel to be scanned to a worker
+     * thread. Each block notes its own largest magnitude so that the
+     * blocks of a channel needn't share a maximum while they run.
+     */
+    struct Scan_params {
+        void* scan;               /*!< The channel's DetectorScan */
+        std::size_t block;        /*!< Block of the scan to run */
+        void* target;             /*!< Complex output of the channel, or nullptr */
+        void* absTarget;          /*!< Magnitude output of the channel, or nullptr */
+        Pooling pooling;          /*!< Pooling of the magnitudes */
+        double mx;                /*!< Largest magnitude written by the block */
+    };
+    /*! The scan of each channel made by scanChannels(), held as a
+     *  std::vector of DetectorScan for the bank's class of detector */
+    std::shared_ptr<void> scans;
+    /*! State at the start of each block of the scans */
+    std::unique_ptr<std::complex<parameter_t>[][2]> scanStates;
+    /*! The blocks made by scanChannels() */
+    std::vector<Scan_params> scanParams;
+    /*! Pointers to each of the blocks, passed to the thread pool */
+    std::vector<void*> scanArgs;
+    /*! Pointers to the blocks run from a zero state, which are all but
+     *  the last of each channel */
+    std::vector<void*> scanFirstPass;
 
     /*!
      * Struct to pass absZ thread parameters to a worker thread.
      */
-    typedef struct {
+    template <typename T>
+    struct AbsZ_params {
         std::size_t start, end;
-        result_t& mx;
-    } AbsZ_params;
+        T& mx;
+    };
+
+    /*! Implementation of both forms of absZ(); parameters are as for absZ(). */
+    template <typename T>
+    T absZValues(T* absFrames,
+                 std::size_t absChans,
+                 const std::size_t absNumFrames,
+                 std::complex<T>* frames,
+                 std::size_t maxThreads) const;
 
     /*! Printable string representations of the flags in the Features enum
      *  Use the provided routines through preference to produce a human-readable
@@ -300,15 +862,17 @@ protected:
     std::size_t currentSample;    /*!< How far along the input for next read */
     parameter_t d;                /*!< Detector damping factor */
     parameter_t sr;               /*!< Operating sample rate */
+    parameter_t inputRate;        /*!< Sample rate of the input */
     Features features;            /*!< Detector method & normalisation */
     parameter_t* bw;              /*!< Array of bandwidths */
     parameter_t gain;             /*!< Audio input gain to be applied */
     
-    /*! If a gain is applied to the input signal, this pointer refers
-     *  to the locally allocated buffer containing the amplified signal
-     *  and inBuf is set to the same address
+    /*! If the input signal is resampled, this pointer refers to the
+     *  locally allocated buffer containing the resampled signal and inBuf
+     *  is set to the same address. Otherwise the caller's buffer is read
+     *  in place, and the gain applied as the detectors read it.
      */
-    std::unique_ptr<inputSample_t[]> gainBuf;
+    std::unique_ptr<inputSample_t[]> resampledBuf;
     
     /*! Standard tuning set for a 12EDO piano keyboard */
     static const parameter_t EDO12_pf[];
@@ -333,6 +897,15 @@ protected:
         const inputSample_t* signal; /*!< Pointer to a frequency-shifted version
                                           of the input data */
         const parameter_t bandwidth; /*!< Detector bandwidth */
+        /*! With shift_on_the_fly, the Hilbert transform of the input,
+         *  from which with signal the detector shifts its input as it
+         *  reads it; otherwise null */
+        const inputSample_t* hilbert {nullptr};
+        FrequencyShift shift {};     /*!< Shift applied to the input
+                                          if hilbert isn't null */
+        /*! Ratio of the sample rate to that of the detector, whose
+         *  signal is then decimated by this factor */
+        std::size_t decimation {1};
     };
     
     /*! Vector of detector_components describing each AbstractDetector in
@@ -357,6 +930,79 @@ protected:
                            const std::size_t numDetectors);
         
     parameter_t modF;  /*!< Frequency above which the signal should be modulated */
+
+    /*!
+     * Input of process(), kept from one block to the next
+     */
+    struct Stream {
+        /*! Shifts the input for the frequency-shifted channels, or null
+         *  if there are none */
+        std::unique_ptr<FrequencyShifterStream> shifter;
+        std::vector<inputSample_t> input;    /*!< Resampled block of input */
+        std::size_t reserved {0};            /*!< Largest block reserved for */
+        std::vector<inputSample_t> delayed;  /*!< Input delayed to match
+                                                  the shifted input */
+        /*! Shifted input for each shift */
+        std::vector<std::vector<inputSample_t>> shifted;
+        /*! Start of each element of shifted */
+        std::vector<inputSample_t*> targets;
+        /*! Index into shifted of each channel's input, or -1 if the
+         *  channel isn't shifted */
+        std::vector<int> shift;
+    };
+    /*! State of the stream fed to process() */
+    Stream stream;
+    /*! Resamples input at a rate other than sr, or null */
+    std::unique_ptr<Resampler> resampler;
+    /*! The file from which the input is read, or null */
+    std::unique_ptr<MappedInput> mapped;
+    /*! Input converted from interleaved or integer audio, if the
+     *  detectors read it, or null */
+    std::unique_ptr<inputSample_t[]> convertedBuf;
+    /*! Make converted audio the input, keeping it if the detectors
+     *  read it rather than a resampled copy of it
+     * \param mono The converted audio
+     * \param numSamples Its length */
+    void setConvertedInput(std::unique_ptr<inputSample_t[]> mono,
+                           const std::size_t numSamples);
+
+    /*! Construct a DetectorBank reading its input from a file, which it
+     *  keeps. Parameters as for the public constructor from a path. */
+    DetectorBank(std::unique_ptr<MappedInput> input,
+                 std::size_t numThreads,
+                 const parameter_t* freqs,
+                 parameter_t* bw,
+                 const std::size_t numDetectors,
+                 Features features,
+                 parameter_t damping,
+                 const parameter_t gain);
+    /*! Advance currentSample past samples the detectors have read,
+     *  letting the pages of a mapped input file holding them go
+     * \param numSamples Number of samples read */
+    void advance(const std::size_t numSamples);
+
+    /*! Set up the stream for the detectors in dbComponents.
+     *  Called by setDBComponents(). */
+    void startStream();
+    /*! Shift and run the detectors on a block of input at sr
+     * \param signal The block of input
+     * \param numSamples Length of the block
+     * \param frames Output array
+     * \param numFrames Frames per channel of the output array
+     * \return Number of frames written to each channel */
+    int processBlock(const inputSample_t* signal, const std::size_t numSamples,
+                     discriminator_t* frames, const std::size_t numFrames);
+    /*! Make room in the stream's buffers for a block
+     * \param numSamples Length of the block */
+    void reserveStream(const std::size_t numSamples);
+    /*! Run the detectors on the stream's input
+     * \param signal Unshifted input
+     * \param numSamples Number of samples of input
+     * \param frames Output array
+     * \param numFrames Length of each channel of the output array
+     * \return Number of frames written to each channel */
+    int runStream(const inputSample_t* signal, const std::size_t numSamples,
+                  discriminator_t* frames, const std::size_t numFrames);
     
 private:
     /*!
@@ -367,7 +1013,12 @@ private:
      * If the f is not provided (nullptr), the initial frequency is set
      * to 0Hz in the expectation that it will be corrected later on during
      * a deserialisation process. In this case, normalisation will also
-     * be skipped.
+     * be skipped. The detectors are made concurrently by the threads of
+     * the ThreadPool. When search normalisation is required, a few
+     * detectors are made first and the searches of the rest start from
+     * corrections interpolated from theirs. With deferred_normalization
+     * the detectors are made unnormalised, and normalised copies are made
+     * by a background thread to find the corrections to apply to them.
      * \param numDetectors Size of the array freqs
      * \param mu Criticality
      * \param d Damping
@@ -382,6 +1033,52 @@ private:
                        const Features features,
                        //const parameter_t b,
                        const parameter_t gain);
+
+    /*!
+     * Make the detectors for every channel, normalising them as given
+     * by features, concurrently in a ThreadPool.
+     * Called by makeDetectors() and, for deferred normalisation, by a
+     * background thread. Other parameters are as for makeDetectors().
+     * \param made Set to the detectors, in order of channel
+     * \param pool Threads among which to share the work
+     * \param deferred Whether the detectors are being made to
+     *        find their normalisations in the background; each result is
+     *        published by publishNormalisation(), and the work is
+     *        abandoned if stopNormaliser is set
+     */
+    void buildDetectors(std::vector<std::unique_ptr<AbstractDetector>>& made,
+                        ThreadPool& pool,
+                        const parameter_t mu,
+                        const parameter_t d,
+                        const parameter_t sr,
+                        const Features features,
+                        const parameter_t gain,
+                        const bool deferred);
+
+    /*!
+     * Make and normalise the detector for one channel.
+     * Called concurrently by makeDetectors(); other parameters are as
+     * for makeDetectors().
+     * \param i Channel number
+     * \param guess Expected ratio of the search normalised frequency
+     *        to the specified frequency, or 0 if unknown
+     * \return The new detector
+     */
+    AbstractDetector* makeDetector(const std::size_t i,
+                                   const parameter_t mu,
+                                   const parameter_t d,
+                                   const parameter_t sr,
+                                   const Features features,
+                                   const parameter_t gain,
+                                   const parameter_t guess = 0);
+
+    /*! Search normalisation of every searchSeedSpacing'th detector
+     *  of each bandwidth starts without a guess. */
+    static constexpr std::size_t searchSeedSpacing { 8 };
+    /*! Ratio of the bounds of a search starting from a guess to the
+     *  guess; 2^(1/150), or 8 cents, for which a single round of
+     *  AbstractDetector::searchNormalize() converges. */
+    static constexpr double warmSearchRange { 1.0046316744020538 };
     
     /*!
      * Mapping of ratio of requested frequency to the maximum
@@ -389,8 +1086,61 @@ private:
      */
     std::map<int, std::unique_ptr<inputSample_t[]>> input_pool;
     
+    /*! With shift_on_the_fly, the Hilbert transform of the input buffer
+     *  shared by all the frequency-shifted channels */
+    std::unique_ptr<inputSample_t[]> hilbertSignal;
+    
+    /*! With multirate, the decimated signals read by the detectors,
+     *  indexed by the signal decimated and the decimation factor */
+    std::map<std::pair<const inputSample_t*, std::size_t>,
+             std::unique_ptr<inputSample_t[]>> decimated_pool;
+    
+    /*! Largest factor by which the input of a detector is decimated */
+    static constexpr std::size_t maxDecimation { 16 };
+    
+    /*! Choose the decimation factor for a detector: the largest power
+     *  of two, at most maxDecimation, at which its frequency and
+     *  bandwidth are no more of the decimated rate than modF is of the
+     *  full rate
+     * \param f Frequency of the detector
+     * \param bandwidth Bandwidth of the detector */
+    std::size_t decimationFor(const parameter_t f, const parameter_t bandwidth) const;
+    
     /*! Has DetectorBank created its own array of zeros for bandwidth? */
     bool auto_bw;
+
+    /*! Queue the normalisation found in the background for a channel
+     *  to be applied by applyNormalisations(), and report progress
+     * \param i Channel number
+     * \param value Result of normalising the channel's detector */
+    void publishNormalisation(const std::size_t i,
+                              const NormalisationCache::Value& value);
+    /*! Apply any queued normalisations to the detectors. Called by
+     *  runDetectors() before the detectors are run. */
+    void applyNormalisations(void);
+    /*! Call the progress callback, if any */
+    void reportNormalisation(void);
+    /*! Abandon any deferred normalisation and wait for its thread */
+    void stopNormalisation(void);
+
+    /*! Thread finding deferred normalisations */
+    std::thread normaliser;
+    /*! Set to make the normaliser thread give up */
+    std::atomic<bool> stopNormaliser { false };
+    /*! Number of detectors whose deferred normalisation has been found */
+    std::atomic<std::size_t> normalisationsFound { 0 };
+    /*! Number of detectors whose normalisation is deferred */
+    std::size_t normalisationsDue { 0 };
+    /*! Deferred normalisations not yet applied, by channel */
+    std::vector<std::pair<std::size_t, NormalisationCache::Value>> pendingNormalisations;
+    /*! Exception thrown by the normaliser thread, rethrown by applyNormalisations() */
+    std::exception_ptr normalisationError;
+    /*! Guards pendingNormalisations and normalisationError */
+    mutable std::mutex normalisationMutex;
+    /*! Progress callback set by setNormalisationCallback() */
+    std::function<void(std::size_t, std::size_t)> normalisationCallback;
+    /*! Serialises calls of normalisationCallback */
+    std::mutex callbackMutex;
 };
 
 #endif
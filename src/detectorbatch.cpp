@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+
+#include "detectorbatch.h"
+#include "detectors.h"
+
+namespace {
+    /*
+     * Right-hand side of the Hopf bifurcation
+     *   dz/dt = (mu + jw)z + b|z|^2 z + x
+     * written out in real and imaginary parts so that a loop over
+     * lanes of these can be vectorised.
+     */
+    template <typename T>
+    inline void hopf(const T mu, const T w, const T b,
+                     const T zr, const T zi, const T x,
+                     T& dr, T& di)
+    {
+        const T bmag { b * (zr*zr + zi*zi) };
+        dr = mu*zr - w*zi + bmag*zr + x;
+        di = mu*zi + w*zr + bmag*zi;
+    }
+}
+
+template <class Solver>
+template <typename T>
+struct DetectorBatch<Solver>::Lanes {
+    // Coefficients. Unused lanes hold a quiescent detector whose
+    // output is discarded.
+    T mu[lanes], w[lanes], b[lanes];
+    T h[lanes];                       // sample period
+    T damp[lanes];                    // 1-d
+    T aRe[lanes], aIm[lanes];         // amplitude normalisation
+    T iScale[lanes];                  // eccentricity correction
+    T eRe[lanes], eIm[lanes];         // exact discretisation multipliers
+    T b0Re[lanes], b0Im[lanes];       //   of zp, xp
+    T b1Re[lanes], b1Im[lanes];       //   and x
+    T sRe[lanes], sIm[lanes];         // semi-implicit multipliers of zp
+    T fRe[lanes], fIm[lanes];         //   and of the forcing
+    // States
+    T zpRe[lanes], zpIm[lanes];       // previous z value
+    T zppRe[lanes], zppIm[lanes];     // z value two samples ago
+    T xp[lanes], xpp[lanes];          // previous audio input samples
+};
+
+// Central difference
+
+template <>
+template <typename T>
+void DetectorBatch<CDDetector>::gather(Lanes<T>& s,
+                                       AbstractDetector* const* detectors,
+                                       const std::size_t numDetectors)
+{
+    for (std::size_t l{0}; l < numDetectors; l++) {
+        const CDDetector* const det { static_cast<CDDetector*>(detectors[l]) };
+        s.mu[l]     = det->mu;
+        s.w[l]      = det->w;
+        s.b[l]      = det->b;
+        s.h[l]      = 1.0/det->sr;
+        s.damp[l]   = 1.0 - det->d;
+        s.aRe[l]    = det->aScale.real();
+        s.aIm[l]    = det->aScale.imag();
+        s.iScale[l] = det->iScale;
+        s.zpRe[l]   = det->zp.real();
+        s.zpIm[l]   = det->zp.imag();
+        s.zppRe[l]  = det->zpp.real();
+        s.zppIm[l]  = det->zpp.imag();
+        s.xp[l]     = det->xp;
+    }
+}
+
+template <>
+template <typename T>
+void DetectorBatch<CDDetector>::scatter(const Lanes<T>& s,
+                                        AbstractDetector* const* detectors,
+                                        const std::size_t numDetectors)
+{
+    for (std::size_t l{0}; l < numDetectors; l++) {
+        CDDetector* const det { static_cast<CDDetector*>(detectors[l]) };
+        det->zp  = std::complex<parameter_t>(s.zpRe[l], s.zpIm[l]);
+        det->zpp = std::complex<parameter_t>(s.zppRe[l], s.zppIm[l]);
+        det->xp  = s.xp[l];
+    }
+}
+
+template <>
+template <typename T>
+void DetectorBatch<CDDetector>::step(Lanes<T>& s, const T* x)
+{
+    // See CDDetector::process() for the scalar version
+    for (std::size_t l{0}; l < lanes; l++) {
+        T dr, di;
+        hopf(s.mu[l], s.w[l], s.b[l], s.zpRe[l], s.zpIm[l], s.xp[l], dr, di);
+        const T twoH { 2*s.h[l] };
+        const T re { (dr*twoH + s.zppRe[l]) * s.damp[l] };
+        const T im { (di*twoH + s.zppIm[l]) * s.damp[l] };
+        s.zppRe[l] = s.zpRe[l];
+        s.zppIm[l] = s.zpIm[l];
+        s.zpRe[l]  = re;
+        s.zpIm[l]  = im;
+        s.xp[l]    = x[l];
+    }
+}
+
+// Fourth order Runge-Kutta
+
+template <>
+template <typename T>
+void DetectorBatch<RK4Detector>::gather(Lanes<T>& s,
+                                        AbstractDetector* const* detectors,
+                                        const std::size_t numDetectors)
+{
+    for (std::size_t l{0}; l < numDetectors; l++) {
+        const RK4Detector* const det { static_cast<RK4Detector*>(detectors[l]) };
+        s.mu[l]     = det->mu;
+        s.w[l]      = det->w;
+        s.b[l]      = det->b;
+        s.h[l]      = 1.0/det->sr;
+        s.damp[l]   = 1.0 - det->d;
+        s.aRe[l]    = det->aScale.real();
+        s.aIm[l]    = det->aScale.imag();
+        s.iScale[l] = det->iScale;
+        s.zpRe[l]   = det->zp.real();
+        s.zpIm[l]   = det->zp.imag();
+        s.zppRe[l]  = det->zpp.real();
+        s.zppIm[l]  = det->zpp.imag();
+        s.xp[l]     = det->xp;
+        s.xpp[l]    = det->xpp;
+    }
+}
+
+template <>
+template <typename T>
+void DetectorBatch<RK4Detector>::scatter(const Lanes<T>& s,
+                                         AbstractDetector* const* detectors,
+                                         const std::size_t numDetectors)
+{
+    for (std::size_t l{0}; l < numDetectors; l++) {
+        RK4Detector* const det { static_cast<RK4Detector*>(detectors[l]) };
+        det->zp  = std::complex<parameter_t>(s.zpRe[l], s.zpIm[l]);
+        det->zpp = std::complex<parameter_t>(s.zppRe[l], s.zppIm[l]);
+        det->xp  = s.xp[l];
+        det->xpp = s.xpp[l];
+    }
+}
+
+template <>
+template <typename T>
+void DetectorBatch<RK4Detector>::step(Lanes<T>& s, const T* x)
+{
+    // See RK4Detector::process() for the scalar version
+    for (std::size_t l{0}; l < lanes; l++) {
+        const T mu { s.mu[l] }, w { s.w[l] }, b { s.b[l] }, h { s.h[l] };
+        T k0r, k0i, k1r, k1i, k2r, k2i, k3r, k3i;
+
+        const T u0r { s.zppRe[l] }, u0i { s.zppIm[l] };
+        hopf(mu, w, b, u0r, u0i, s.xpp[l], k0r, k0i);
+
+        const T u1r { u0r + k0r*h }, u1i { u0i + k0i*h };
+        hopf(mu, w, b, u1r, u1i, s.xp[l], k1r, k1i);
+
+        const T u2r { u0r + k1r*h }, u2i { u0i + k1i*h };
+        hopf(mu, w, b, u2r, u2i, s.xp[l], k2r, k2i);
+
+        const T u3r { u0r + k2r*2*h }, u3i { u0i + k2i*2*h };
+        hopf(mu, w, b, u3r, u3i, x[l], k3r, k3i);
+
+        const T third { h/3 };
+        s.zppRe[l] = s.zpRe[l];
+        s.zppIm[l] = s.zpIm[l];
+        s.zpRe[l]  = (u0r + (k0r + 2*k1r + 2*k2r + k3r)*third) * s.damp[l];
+        s.zpIm[l]  = (u0i + (k0i + 2*k1i + 2*k2i + k3i)*third) * s.damp[l];
+        s.xpp[l]   = s.xp[l];
+        s.xp[l]    = x[l];
+    }
+}
+
+// Exact discretisation of the linear detector
+
+template <>
+template <typename T>
+void DetectorBatch<ExactDetector>::gather(Lanes<T>& s,
+                                          AbstractDetector* const* detectors,
+                                          const std::size_t numDetectors)
+{
+    for (std::size_t l{0}; l < numDetectors; l++) {
+        const ExactDetector* const det { static_cast<ExactDetector*>(detectors[l]) };
+        std::complex<parameter_t> e, b0, b1;
+        det->coefficients(e, b0, b1);
+        s.eRe[l]    = e.real();
+        s.eIm[l]    = e.imag();
+        s.b0Re[l]   = b0.real();
+        s.b0Im[l]   = b0.imag();
+        s.b1Re[l]   = b1.real();
+        s.b1Im[l]   = b1.imag();
+        s.aRe[l]    = det->aScale.real();
+        s.aIm[l]    = det->aScale.imag();
+        s.iScale[l] = det->iScale;
+        s.zpRe[l]   = det->zp.real();
+        s.zpIm[l]   = det->zp.imag();
+        s.xp[l]     = det->xp;
+    }
+}
+
+template <>
+template <typename T>
+void DetectorBatch<ExactDetector>::scatter(const Lanes<T>& s,
+                                           AbstractDetector* const* detectors,
+                                           const std::size_t numDetectors)
+{
+    for (std::size_t l{0}; l < numDetectors; l++) {
+        ExactDetector* const det { static_cast<ExactDetector*>(detectors[l]) };
+        det->zp = std::complex<parameter_t>(s.zpRe[l], s.zpIm[l]);
+        det->xp = s.xp[l];
+    }
+}
+
+template <>
+template <typename T>
+void DetectorBatch<ExactDetector>::step(Lanes<T>& s, const T* x)
+{
+    // See ExactDetector::process() for the scalar version
+    for (std::size_t l{0}; l < lanes; l++) {
+        const T zr { s.zpRe[l] }, zi { s.zpIm[l] };
+        s.zpRe[l] = s.eRe[l]*zr - s.eIm[l]*zi + s.b0Re[l]*s.xp[l] + s.b1Re[l]*x[l];
+        s.zpIm[l] = s.eRe[l]*zi + s.eIm[l]*zr + s.b0Im[l]*s.xp[l] + s.b1Im[l]*x[l];
+        s.xp[l]   = x[l];
+    }
+}
+
+// Semi-implicit
+
+template <>
+template <typename T>
+void DetectorBatch<SemiImplicitDetector>::gather(Lanes<T>& s,
+                                                 AbstractDetector* const* detectors,
+                                                 const std::size_t numDetectors)
+{
+    for (std::size_t l{0}; l < numDetectors; l++) {
+        const SemiImplicitDetector* const det {
+            static_cast<SemiImplicitDetector*>(detectors[l])
+        };
+        std::complex<parameter_t> a, c;
+        det->coefficients(a, c);
+        s.sRe[l]    = a.real();
+        s.sIm[l]    = a.imag();
+        s.fRe[l]    = c.real();
+        s.fIm[l]    = c.imag();
+        s.b[l]      = det->b;
+        s.aRe[l]    = det->aScale.real();
+        s.aIm[l]    = det->aScale.imag();
+        s.iScale[l] = det->iScale;
+        s.zpRe[l]   = det->zp.real();
+        s.zpIm[l]   = det->zp.imag();
+        s.zppRe[l]  = det->zpp.real();
+        s.zppIm[l]  = det->zpp.imag();
+        s.xp[l]     = det->xp;
+    }
+}
+
+template <>
+template <typename T>
+void DetectorBatch<SemiImplicitDetector>::scatter(const Lanes<T>& s,
+                                                  AbstractDetector* const* detectors,
+                                                  const std::size_t numDetectors)
+{
+    for (std::size_t l{0}; l < numDetectors; l++) {
+        SemiImplicitDetector* const det {
+            static_cast<SemiImplicitDetector*>(detectors[l])
+        };
+        det->zp  = std::complex<parameter_t>(s.zpRe[l], s.zpIm[l]);
+        det->zpp = std::complex<parameter_t>(s.zppRe[l], s.zppIm[l]);
+        det->xp  = s.xp[l];
+    }
+}
+
+template <>
+template <typename T>
+void DetectorBatch<SemiImplicitDetector>::step(Lanes<T>& s, const T* x)
+{
+    // See SemiImplicitDetector::process() for the scalar version
+    for (std::size_t l{0}; l < lanes; l++) {
+        const T zr { s.zpRe[l] }, zi { s.zpIm[l] };
+        const T np { T(1.5) * s.b[l] * (zr*zr + zi*zi) };
+        const T npp { T(0.5) * s.b[l] * (s.zppRe[l]*s.zppRe[l] + s.zppIm[l]*s.zppIm[l]) };
+        const T input { T(0.5) * (x[l] + s.xp[l]) };
+        const T fr { np*zr - npp*s.zppRe[l] + input };
+        const T fi { np*zi - npp*s.zppIm[l] };
+        s.zppRe[l] = zr;
+        s.zppIm[l] = zi;
+        s.zpRe[l]  = s.sRe[l]*zr - s.sIm[l]*zi + s.fRe[l]*fr - s.fIm[l]*fi;
+        s.zpIm[l]  = s.sRe[l]*zi + s.sIm[l]*zr + s.fRe[l]*fi + s.fIm[l]*fr;
+        s.xp[l]    = x[l];
+    }
+}
+
+// Common driver
+
+template <class Solver>
+template <typename T, class Write>
+void DetectorBatch<Solver>::run(AbstractDetector* const* detectors,
+                                const inputSample_t* const* sources,
+                                const std::size_t numDetectors,
+                                const std::size_t count,
+                                const inputSample_t* const* hilberts,
+                                FrequencyShift* const* shifts,
+                                const std::size_t decimation,
+                                const std::size_t skip,
+                                const parameter_t gain,
+                                Write write)
+{
+    Lanes<T> s {};
+    gather(s, detectors, numDetectors);
+
+    // The detectors step at every decimation'th sample from sample skip,
+    // reading consecutive source samples, and hold their outputs between
+    std::size_t wait {skip}, i {0};
+    for (std::size_t n{0}; n < count; n++) {
+        if (wait == 0) {
+            // The input is amplified as it is read, to the precision
+            // in which the detectors keep their previous inputs
+            T x[lanes] {};
+            for (std::size_t l{0}; l < numDetectors; l++)
+                x[l] = inputSample_t(gain * (hilberts && hilberts[l]
+                                                 ? shifts[l]->next(sources[l][i], hilberts[l][i])
+                                                 : sources[l][i]));
+
+            step(s, x);
+            i++;
+            wait = decimation;
+        }
+        wait--;
+
+        // Amplitude normalisation and eccentricity correction
+        T re[lanes], im[lanes];
+        for (std::size_t l{0}; l < lanes; l++) {
+            re[l] = s.zpRe[l]*s.aRe[l] - s.zpIm[l]*s.aIm[l];
+            im[l] = (s.zpRe[l]*s.aIm[l] + s.zpIm[l]*s.aRe[l]) * s.iScale[l];
+        }
+        write(n, re, im);
+    }
+
+    scatter(s, detectors, numDetectors);
+}
+
+template <class Solver>
+template <typename T>
+void DetectorBatch<Solver>::process(AbstractDetector* const* detectors,
+                                    std::complex<T>* const* targets,
+                                    const inputSample_t* const* sources,
+                                    const std::size_t numDetectors,
+                                    const std::size_t count,
+                                    const std::size_t hop,
+                                    const inputSample_t* const* hilberts,
+                                    FrequencyShift* const* shifts,
+                                    const std::size_t decimation,
+                                    const std::size_t skip,
+                                    const parameter_t gain)
+{
+    // Output frame k is written from sample k*hop
+    std::size_t k {0}, phase {0};
+
+    run<T>(detectors, sources, numDetectors, count, hilberts, shifts,
+           decimation, skip, gain,
+           [&](const std::size_t, const T* re, const T* im) {
+               if (phase == 0) {
+                   for (std::size_t l{0}; l < numDetectors; l++)
+                       targets[l][k] = std::complex<T>(re[l], im[l]);
+                   k++;
+               }
+               if (++phase == hop)
+                   phase = 0;
+           });
+}
+
+template <class Solver>
+template <typename T>
+void DetectorBatch<Solver>::process(AbstractDetector* const* detectors,
+                                    T* const* targets,
+                                    T* maxima,
+                                    const inputSample_t* const* sources,
+                                    const std::size_t numDetectors,
+                                    const std::size_t count,
+                                    const std::size_t hop,
+                                    const DetectorBank::Pooling pooling,
+                                    const inputSample_t* const* hilberts,
+                                    FrequencyShift* const* shifts,
+                                    const std::size_t decimation,
+                                    const std::size_t skip,
+                                    const parameter_t gain)
+{
+    T mx[lanes] {}, acc[lanes] {};
+    std::size_t k {0}, phase {0};
+
+    run<T>(detectors, sources, numDetectors, count, hilberts, shifts,
+           decimation, skip, gain,
+           [&](const std::size_t n, const T* re, const T* im) {
+               // The largest |z| is found from |z|^2, so the square
+               // root is taken only once per hop.
+               if (pooling == DetectorBank::mean_power)
+                   for (std::size_t l{0}; l < lanes; l++)
+                       acc[l] += re[l]*re[l] + im[l]*im[l];
+               else
+                   for (std::size_t l{0}; l < lanes; l++)
+                       acc[l] = std::max(acc[l], re[l]*re[l] + im[l]*im[l]);
+
+               if (++phase == hop || n+1 == count) {
+                   for (std::size_t l{0}; l < numDetectors; l++) {
+                       const T v {
+                           pooling == DetectorBank::mean_power ? acc[l]/phase
+                                                               : std::sqrt(acc[l])
+                       };
+                       targets[l][k] = v;
+                       mx[l] = std::max(mx[l], v);
+                       acc[l] = 0;
+                   }
+                   k++;
+                   phase = 0;
+               }
+           });
+
+    if (maxima)
+        for (std::size_t l{0}; l < numDetectors; l++)
+            maxima[l] = std::max(maxima[l], mx[l]);
+}
+
+template void DetectorBatch<CDDetector>::process<double>(
+    AbstractDetector* const*, std::complex<double>* const*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<CDDetector>::process<float>(
+    AbstractDetector* const*, std::complex<float>* const*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<RK4Detector>::process<double>(
+    AbstractDetector* const*, std::complex<double>* const*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<RK4Detector>::process<float>(
+    AbstractDetector* const*, std::complex<float>* const*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<ExactDetector>::process<double>(
+    AbstractDetector* const*, std::complex<double>* const*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<ExactDetector>::process<float>(
+    AbstractDetector* const*, std::complex<float>* const*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<SemiImplicitDetector>::process<double>(
+    AbstractDetector* const*, std::complex<double>* const*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<SemiImplicitDetector>::process<float>(
+    AbstractDetector* const*, std::complex<float>* const*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<CDDetector>::process<double>(
+    AbstractDetector* const*, double* const*, double*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const DetectorBank::Pooling,
+    const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<CDDetector>::process<float>(
+    AbstractDetector* const*, float* const*, float*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const DetectorBank::Pooling,
+    const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<RK4Detector>::process<double>(
+    AbstractDetector* const*, double* const*, double*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const DetectorBank::Pooling,
+    const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<RK4Detector>::process<float>(
+    AbstractDetector* const*, float* const*, float*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const DetectorBank::Pooling,
+    const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<ExactDetector>::process<double>(
+    AbstractDetector* const*, double* const*, double*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const DetectorBank::Pooling,
+    const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<ExactDetector>::process<float>(
+    AbstractDetector* const*, float* const*, float*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const DetectorBank::Pooling,
+    const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<SemiImplicitDetector>::process<double>(
+    AbstractDetector* const*, double* const*, double*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const DetectorBank::Pooling,
+    const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
+template void DetectorBatch<SemiImplicitDetector>::process<float>(
+    AbstractDetector* const*, float* const*, float*,
+    const inputSample_t* const*, const std::size_t, const std::size_t,
+    const std::size_t, const DetectorBank::Pooling,
+    const inputSample_t* const*, FrequencyShift* const*,
+    const std::size_t, const std::size_t, const parameter_t);
@@ -0,0 +1,200 @@
+#ifndef _DETECTORBATCH_H_
+#define _DETECTORBATCH_H_
+
+#include <cstddef>
+#include <complex>
+
+#include "detectorbank.h"
+#include "detectortypes.h"
+#include "frequencyshifter.h"
+
+class AbstractDetector;
+
+/*!
+ * Advance a group of detectors of the same type in lock-step.
+ *
+ * The states of up to \ref lanes detectors (zp, zpp, xp, xpp) and their
+ * coefficients (w, b, mu, d and the amplitude normalisation factors) are
+ * gathered into structure-of-arrays form at the start of a call. Each
+ * input sample is then applied to every detector in the group by a
+ * fixed-length loop over the lanes which the compiler is able to
+ * vectorise (two lanes per SSE2 register, four with AVX2 and eight with
+ * AVX-512 when the library is built with the corresponding `-march`
+ * flags). Because the lanes are independent, the dependency chain of
+ * the numerical method in one detector is hidden behind the work done
+ * for the others. The states are scattered back into the detectors when
+ * the call completes, so the scalar AbstractDetector::processAudio() path
+ * may be freely interleaved with the batched one.
+ *
+ * The arithmetic is identical to that of the scalar process() methods
+ * except that complex products are expanded into their real and
+ * imaginary parts, \f$|z|^2\f$ is formed as \f$\Re(z)^2+\Im(z)^2\f$
+ * and divisions by the sample rate are replaced by multiplications by
+ * its reciprocal. The two paths therefore agree to within a few units
+ * in the last place per sample; over a one second, full-scale tone the
+ * largest difference observed is of the order of \f$10^{-13}\f$ relative
+ * to the peak output, and the unit tests require agreement to within
+ * \f$10^{-9}\f$.
+ *
+ * The same kernels may be run in single precision by supplying
+ * single-precision output arrays. The coefficients and states are then
+ * rounded to float when they are gathered, every per-sample operation
+ * is performed in float (halving the memory traffic and doubling the
+ * number of lanes per vector register) and the states are widened
+ * again when they are scattered back to the detectors. Single-precision
+ * results track the double-precision ones to within about
+ * \f$10^{-3}\f$ of the peak output over a one second tone for
+ * minimum-bandwidth detectors, which is verified by the unit tests.
+ *
+ * Where only \f$|z|\f$ is wanted the magnitudes may be written directly
+ * (with a running maximum for each detector if required), avoiding the
+ * intermediate complex array and a second pass over it. The output may
+ * also be decimated, or its magnitudes pooled over a hop of samples, as
+ * it is made.
+ *
+ * The input of any detector may be frequency shifted as it is read,
+ * from the input and its Hilbert transform, rather than being read from
+ * a shifted copy of the input (see DetectorBank::shift_on_the_fly).
+ * A group of detectors may also be run on decimated input, at a fraction
+ * of the output rate, holding each output until the next input sample
+ * (see DetectorBank::multirate). The input is amplified as it is read,
+ * so the sources needn't be amplified copies of the input.
+ *
+ * \tparam Solver The detector class (CDDetector, RK4Detector,
+ *                ExactDetector or SemiImplicitDetector) whose numerical
+ *                method the batch implements.
+ */
+template <class Solver>
+class DetectorBatch {
+public:
+    /*! Maximum number of detectors advanced together */
+    static constexpr std::size_t lanes { 8 };
+
+    /*!
+     * Process count samples for each of a group of detectors.
+     * The detectors must all be of type Solver.
+     * \tparam T Precision in which the detectors are advanced
+     *           (float or double)
+     * \param detectors Detectors to be advanced
+     * \param targets Output array for each detector
+     * \param sources Input samples for each detector
+     * \param numDetectors Number of detectors in the group (at most lanes)
+     * \param count Number of frames to process
+     * \param hop If greater than 1, only every hop'th output is
+     *            written, to consecutive elements of the targets
+     * \param hilberts If not null, the Hilbert transform of the input
+     *                 samples of each detector whose input is to be
+     *                 shifted, or null for those whose input isn't
+     * \param shifts Shift applied to the input of each detector for
+     *               which hilberts is not null, whose phase is advanced
+     *               past the samples processed
+     * \param decimation Number of frames per sample of the sources
+     * \param skip Number of frames before the first sample of the
+     *             sources is read, during which the detectors' current
+     *             outputs are repeated; less than decimation
+     * \param gain Gain applied to the input samples as they are read
+     */
+    template <typename T>
+    static void process(AbstractDetector* const* detectors,
+                        std::complex<T>* const* targets,
+                        const inputSample_t* const* sources,
+                        const std::size_t numDetectors,
+                        const std::size_t count,
+                        const std::size_t hop = 1,
+                        const inputSample_t* const* hilberts = nullptr,
+                        FrequencyShift* const* shifts = nullptr,
+                        const std::size_t decimation = 1,
+                        const std::size_t skip = 0,
+                        const parameter_t gain = 1);
+
+    /*!
+     * Process count samples for each of a group of detectors, writing
+     * only the magnitude of each normalised output, or the magnitudes
+     * pooled over each hop of outputs.
+     * The detectors must all be of type Solver.
+     * \tparam T Precision in which the detectors are advanced
+     *           (float or double)
+     * \param detectors Detectors to be advanced
+     * \param targets Output array of magnitudes for each detector
+     * \param maxima If not null, maxima[i] is raised to the largest
+     *               value written to targets[i]
+     * \param sources Input samples for each detector
+     * \param numDetectors Number of detectors in the group (at most lanes)
+     * \param count Number of frames to process
+     * \param hop Number of outputs pooled into each element of the
+     *            targets; the last may be pooled over fewer
+     * \param pooling How each hop is pooled
+     * \param hilberts As for the complex process()
+     * \param shifts As for the complex process()
+     * \param decimation As for the complex process()
+     * \param skip As for the complex process()
+     * \param gain As for the complex process()
+     */
+    template <typename T>
+    static void process(AbstractDetector* const* detectors,
+                        T* const* targets,
+                        T* maxima,
+                        const inputSample_t* const* sources,
+                        const std::size_t numDetectors,
+                        const std::size_t count,
+                        const std::size_t hop = 1,
+                        const DetectorBank::Pooling pooling = DetectorBank::max_abs,
+                        const inputSample_t* const* hilberts = nullptr,
+                        FrequencyShift* const* shifts = nullptr,
+                        const std::size_t decimation = 1,
+                        const std::size_t skip = 0,
+                        const parameter_t gain = 1);
+
+private:
+    /*! Coefficients and states of a group of detectors in
+     *  structure-of-arrays form */
+    template <typename T> struct Lanes;
+
+    /*! Read the coefficients and states of the detectors into lanes
+     * \param s Lanes to be filled
+     * \param detectors Detectors to be read
+     * \param numDetectors Number of detectors */
+    template <typename T>
+    static void gather(Lanes<T>& s,
+                       AbstractDetector* const* detectors,
+                       const std::size_t numDetectors);
+    /*! Write the states held in lanes back to the detectors
+     * \param s Lanes to be read
+     * \param detectors Detectors to be updated
+     * \param numDetectors Number of detectors */
+    template <typename T>
+    static void scatter(const Lanes<T>& s,
+                        AbstractDetector* const* detectors,
+                        const std::size_t numDetectors);
+    /*! Advance every lane by one sample
+     * \param s Lanes to be advanced
+     * \param x Current input sample for each lane */
+    template <typename T>
+    static void step(Lanes<T>& s, const T* x);
+    /*! Advance the detectors by count samples, passing the normalised
+     *  output of every lane to write after each sample
+     * \param detectors Detectors to be advanced
+     * \param sources Input samples for each detector
+     * \param numDetectors Number of detectors
+     * \param count Number of frames to process
+     * \param hilberts Hilbert transforms of shifted inputs, or null
+     * \param shifts Shifts of the inputs for which hilberts is not null
+     * \param decimation Number of frames per sample of the sources
+     * \param skip Number of frames before the first sample is read
+     * \param gain Gain applied to the input samples
+     * \param write Called as write(n, re, im) with the real and
+     *              imaginary parts of output n of each lane */
+    template <typename T, class Write>
+    static void run(AbstractDetector* const* detectors,
+                    const inputSample_t* const* sources,
+                    const std::size_t numDetectors,
+                    const std::size_t count,
+                    const inputSample_t* const* hilberts,
+                    FrequencyShift* const* shifts,
+                    const std::size_t decimation,
+                    const std::size_t skip,
+                    const parameter_t gain,
+                    Write write);
+};
+
+#endif
@@ -16,7 +16,6 @@ std::size_t detectorcache::Producer::generate(result_t* seg[],
 //     const std::size_t chans = db.getChans();
     const std::size_t chans = size;
     
-    discriminator_t* zComplex = new discriminator_t[seg_len*chans];
     //TODO Check that SlidingBuffer guarantees to make idx increase by size
     //TODO Maybe worth an assert here.
     
@@ -48,11 +47,9 @@ std::size_t detectorcache::Producer::generate(result_t* seg[],
         db.setInputBuffer(audiobuf, seg_len);
     }
     
-    db.getZ(zComplex, chans, samples_to_process, start_chan);
-    db.absZ(seg[0], chans, samples_to_process, zComplex);
+    db.getAbsZ(seg[0], chans, samples_to_process, start_chan);
     
     if (audiobuf) delete[] audiobuf;
-    delete[] zComplex;
 
     //FIXME At the moment what gets returned is the number of channels
     // for which data is stored. Now it's possible to pass an istream,
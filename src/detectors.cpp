@@ -1,8 +1,9 @@
+#include <algorithm>
+#include <cmath>
 #include <complex>
 #include <utility>
 #include <memory>
 #include <string>
-#include <typeinfo>
 #include <string>
 
 #include <iostream>
@@ -17,8 +18,10 @@
 
 AbstractDetector::AbstractDetector(parameter_t f, parameter_t mu, 
                                    parameter_t d, parameter_t sr, 
-                                   parameter_t detBw, parameter_t gain)
-    : w(f*2.0*M_PI)
+                                   parameter_t detBw, parameter_t gain,
+                                   DetectorBank::Features solver)
+    : solver(solver)
+    , w(f*2.0*M_PI)
     , mu(mu)
     , d(d)
     , sr(sr)
@@ -37,21 +40,9 @@ AbstractDetector::~AbstractDetector()
 void AbstractDetector::processAudio(discriminator_t* target,
                                     const inputSample_t* start, std::size_t count)
 {
-    // perform Hopf bifurcation calculation
+    // perform Hopf bifurcation calculation. Amplitude normalisation and
+    // eccentricity correction are applied as each sample is written.
     process(target, start, count);
-    
-    // combine amplitude scaling and amplitude normalisation factor into single value
-    const discriminator_t totalScale {scale * aScale};
-
-    for (std::size_t i{0}; i < count; i++) {
-        *target *= aScale; // totalScale;
-        
-        const auto re { std::real(*target) };
-        const auto im { std::imag(*target) };
-        *target = discriminator_t(re, im*iScale); // correcting eccentricity
-        
-        target++;
-    }
 }
 
 const parameter_t AbstractDetector::getLyapunov(const parameter_t bw, const parameter_t amp)
@@ -72,10 +63,11 @@ const parameter_t AbstractDetector::getLyapunov(const parameter_t bw, const para
 
 void AbstractDetector::generateTone(inputSample_t* tone,
                                     const std::size_t duration,
-                                    const parameter_t frequency)
+                                    const parameter_t frequency,
+                                    const std::size_t start)
 {
-    inputSample_t theta(0);
     const inputSample_t wPerS(2.*M_PI*frequency/sr);
+    inputSample_t theta(std::fmod(start * (2.*M_PI*frequency/sr), 2.*M_PI));
     
     for (std::size_t i{0}; i < duration; i++) {
         tone[i] = sin(theta);
@@ -93,133 +85,122 @@ bool AbstractDetector::searchNormalize(parameter_t searchStart,
     
     // Specified detector frequency
     const parameter_t f_spec { w/(2.0*M_PI) };
-    // The frequency actually required to achieve that.
-    parameter_t f { f_spec };
     
-    DetectorBank::Features method;
-    
-    // Determine this's numerical method
-    if (typeid(*this) == typeid(CDDetector))
-        method = DetectorBank::Features::central_difference;
-    else if (typeid(*this) == typeid(RK4Detector))
-        method = DetectorBank::Features::runge_kutta;
-    else
-        throw std::runtime_error(
-            "Invalid detector type while attempting search-normalization"
-        );
-        
+    // Look from 75% to 90% of the tone to find max amplitudes, so the
+    // remainder of the tone needn't be run
     const std::size_t samples { static_cast<std::size_t>(toneDuration*sr) };
-    inputSample_t tone[samples];
-    generateTone(tone, samples, f);
-
-    std::unique_ptr<discriminator_t[]> results(new discriminator_t[3*samples]);
-
-    // Initial search parameters
-    parameter_t testFreq[] { searchStart * f, searchEnd * f, f };
-    
-    std::size_t test_len = sizeof(testFreq)/sizeof(testFreq[0]);
-    parameter_t test_bw[test_len];
-    std::fill_n(test_bw, test_len, detBw);  
-    
-    int iteration{0};     // Number of attempts so far
-    
-    
-    
-    // On the first iteration, check that the target
-    // frequency produces greater output than the upper
-    // and lower estimates. If the upper and lower
-    // estimates do not span the target frequency,
-    // immediately return failure
-    std::unique_ptr<DetectorBank> db(
-        new DetectorBank(sr, tone, samples, 3, testFreq, test_bw, 3,
-                         static_cast<DetectorBank::Features>(
-                            method|DetectorBank::Features::freq_unnormalized|
-                            DetectorBank::Features::amp_unnormalized
-                         ), d, forcingAmplitude)
-    );    
-    db->getZ(results.get(), 3, samples);
-
-    // Look from 75% to 90% of the tone to find max amplitudes
     const std::size_t testFrom { 3*samples / 4 };
     const std::size_t testTo { 9*samples / 10 };
-    double amplitudes[] = {0.0, 0.0, 0.0};
-    
-    // Results contains the output from all the detectors,
-    // with a stride of samples. We'll loop though the outputs
-    // keeping the largest magnitude. In the case of the
-    // first detector, we'll keep the index of the biggest
-    // magnitude too, so it can be used for gain normalization
-    // and stiffness correction later.
-    for (std::size_t i{testFrom}; i < testTo; i++) {
-        for (std::size_t j{0}; j < 3; j++) {
-            amplitudes[j] =
-                std::max(std::abs(results[j*samples + i]), amplitudes[j]);
+    std::unique_ptr<inputSample_t[]> tone(new inputSample_t[testTo]);
+    generateTone(tone.get(), testTo, f_spec);
+
+    std::unique_ptr<result_t[]> results(new result_t[searchBatch*testTo]);
+    parameter_t test_bw[searchBatch];
+    std::fill_n(test_bw, searchBatch, detBw);
+
+    // Find the greatest response of a detector at each of the
+    // searchBatch frequencies in a single run
+    auto measure {
+        [&](const parameter_t* testFreq, result_t* amplitudes) {
+            DetectorBank db(sr, sr, tone.get(), testTo, 1, testFreq, test_bw, searchBatch,
+                            static_cast<DetectorBank::Features>(
+                                solver|DetectorBank::Features::freq_unnormalized|
+                                DetectorBank::Features::amp_unnormalized
+                            ), d, forcingAmplitude);
+            db.getAbsZ(results.get(), searchBatch, testTo);
+
+            for (std::size_t j{0}; j < searchBatch; j++) {
+                const result_t* r { results.get() + j*testTo };
+                amplitudes[j] = *std::max_element(r + testFrom, r + testTo);
+            }
         }
-    }
+    };
 
-    if (amplitudes[0] > amplitudes[2] || amplitudes[1] > amplitudes[2]) {
-        std::cout << "Searching for normalized characteristic frequency: "
-                "test range does not span maximum response.\n";
-        return false;
+    // Points of the current round, equally spaced in log frequency
+    // from the lower to the upper bound, and their responses
+    const std::size_t maxPoints { searchBatch + 2 };
+    parameter_t logFreq[maxPoints];
+    result_t amplitudes[maxPoints];
+    parameter_t testFreq[searchBatch];
+
+    // The first round tests searchBatch frequencies including both
+    // bounds. If the best response is at either bound, they do not
+    // span the maximum response, so immediately return failure.
+    std::size_t points { searchBatch };
+    for (std::size_t j{0}; j < points; j++) {
+        logFreq[j] = std::log(f_spec) + std::log(searchStart) +
+                     j * std::log(searchEnd/searchStart) / (points - 1);
+        testFreq[j] = std::exp(logFreq[j]);
     }
+    measure(testFreq, amplitudes);
     
-    // Now iterate to find best response. On each iteration,
-    // the search range is reduced by moving the frequency
-    // with the lowest amplitude response half way towards
-    // the centre frequency
+    std::size_t best = std::max_element(amplitudes, amplitudes + points) - amplitudes;
+    if (best == 0 || best == points - 1)
+        return false;
+
+    // Now narrow the range to the neighbours of the best response. Their
+    // responses are known, so each later round tests searchBatch new
+    // frequencies between them, shrinking the range by a factor of
+    // (searchBatch + 1)/2 per run of the test detectors.
 #   if DEBUG & 2 
     std::ofstream zf;
 #   endif
+    int iteration{0};     // Number of rounds so far
+    
     while (
         iteration++ < maxNormIterations &&
-        testFreq[1]/testFreq[0] > normConverged
+        std::exp(logFreq[best+1] - logFreq[best-1]) > normConverged
     ) {
-        const double cf = 0.5*(testFreq[0] + testFreq[1]);
-        if (amplitudes[0] < amplitudes[1])
-            testFreq[0] = 0.5*(testFreq[0] + cf);
-        else
-            testFreq[1] = 0.5*(testFreq[1] + cf);
-        
-        // Get a new bunch of detectors
-        db.reset(
-            new DetectorBank(sr, tone, samples, 2, testFreq, test_bw, 2, 
-                             static_cast<DetectorBank::Features>(
-                                method|DetectorBank::Features::freq_unnormalized|
-                                DetectorBank::Features::amp_unnormalized),
-                             d, forcingAmplitude)
-        );
-        
-        // Perform new analysis runs using just the upper and lower bounds
-        db->getZ(results.get(), 2, samples);
-        
-        // Search for maxima.
-        amplitudes[0] = amplitudes[1] = 0.0;
-        for (std::size_t i{testFrom}; i < testTo; i++) {
-            for (std::size_t j{0}; j < 2; j++) {
-                amplitudes[j] =
-                    std::max(std::abs(results[j*samples + i]), amplitudes[j]);
-            }
-        }
-        
-        f = 0.5 * (testFreq[0] + testFreq[1]);
-        w = 2*M_PI*f;
-        
+        const parameter_t lower { logFreq[best-1] };
+        const parameter_t upper { logFreq[best+1] };
+        const result_t lowerAmp { amplitudes[best-1] };
+        const result_t upperAmp { amplitudes[best+1] };
+
+        points = maxPoints;
+        for (std::size_t j{0}; j < points; j++)
+            logFreq[j] = lower + j * (upper - lower) / (points - 1);
+        for (std::size_t j{0}; j < searchBatch; j++)
+            testFreq[j] = std::exp(logFreq[j+1]);
+
+        amplitudes[0] = lowerAmp;
+        measure(testFreq, amplitudes + 1);
+        amplitudes[points-1] = upperAmp;
+
+        best = std::max_element(amplitudes, amplitudes + points) - amplitudes;
+        // The bounds were beaten by the previous best, so should only win
+        // if the responses are too flat to tell apart
+        best = std::min(std::max(best, std::size_t(1)), points - 2);
+
 #       if DEBUG & 2 
         zf.open("/tmp/z.dat", std::ofstream::out | std::ofstream::app);
     
         zf << "===== ITERATION " << iteration << std::endl;
         zf << "frequencies: "
-            << testFreq[0] << ", "
-            << testFreq[1] << std::endl;
-        zf << "amplitudes:  "
-            << amplitudes[0] << ", "
-            << amplitudes[1] << std::endl;
-        zf << "Ratio of upper to lower test tone frequency: "
-            << testFreq[1]/testFreq[0] << std::endl;
+            << std::exp(lower) << ", "
+            << std::exp(upper) << std::endl;
+        zf << "best:  "
+            << testFreq[best-1] << ", "
+            << amplitudes[best] << std::endl;
+        zf.close();
 #       endif
     }
     
+    // Place the characteristic frequency at the peak of the parabola
+    // through the best response and its neighbours. As the best response
+    // is no less than its neighbours, this lies no more than half the
+    // spacing of the points from it.
+    const result_t y0 { amplitudes[best-1] };
+    const result_t y1 { amplitudes[best] };
+    const result_t y2 { amplitudes[best+1] };
+    const result_t curvature { y0 - 2*y1 + y2 };
+    const parameter_t offset { curvature < 0 ? 0.5 * (y0 - y2) / curvature : 0.0 };
+    const parameter_t f {
+        std::exp(logFreq[best] + offset * (logFreq[best+1] - logFreq[best]))
+    };
+    w = 2*M_PI*f;
+    
 #   if DEBUG & 2     
+    zf.open("/tmp/z.dat", std::ofstream::out | std::ofstream::app);
     zf << "=== Best correction:\n\tUse f=" << f
     << " (for f_spec=" << f_spec << ");" << std::endl;
 #   endif
@@ -227,67 +208,79 @@ bool AbstractDetector::searchNormalize(parameter_t searchStart,
     return true;
 }
     
-bool AbstractDetector::amplitudeNormalize(const parameter_t forcingAmplitude)
+std::size_t AbstractDetector::amplitudeNormalize(const parameter_t forcingAmplitude,
+                                                 const parameter_t tolerance)
 {
-    // make tone and detector at detector frequency (3 seconds)
+    // Longest tone to use if the response hasn't settled (seconds)
     const std::size_t dur {60};
-        
-    const std::size_t samples { static_cast<std::size_t>(dur*sr) };
-    
-    std::unique_ptr<inputSample_t[]> tone(new inputSample_t[samples]);
+    const std::size_t maxSamples { static_cast<std::size_t>(dur*sr) };
 
     const parameter_t f { w/(2.0*M_PI) };
-    
-    generateTone(&tone[0], samples, f);
-    
-    DetectorBank::Features method;
-    
-    // Determine this's numerical method
-    if (typeid(*this) == typeid(CDDetector))
-        method = DetectorBank::Features::central_difference;
-    else if (typeid(*this) == typeid(RK4Detector))
-        method = DetectorBank::Features::runge_kutta;
-    else
-        throw std::runtime_error(
-            "Invalid detector type while attempting amplitude normalization"
-        );
-    
+
+    // number of oscillations over which to find eccentricity
+    const std::size_t nOsc {5};
+    // number of samples in nOsc oscillations
+    const std::size_t sOsc {static_cast<std::size_t>(sr * nOsc/f)};
+
+    // The tone is made and run in blocks of a fifth of a second or
+    // long enough to hold the oscillations used for the eccentricity.
+    const std::size_t blockLen { std::max(sOsc, static_cast<std::size_t>(sr/5)) };
+
+    std::unique_ptr<inputSample_t[]> tone(new inputSample_t[blockLen]);
+    std::unique_ptr<discriminator_t[]> results(new discriminator_t[blockLen]);
+
     parameter_t test_bw[] {detBw};
     
     // make a DetectorBank with the same method and f_norm and damping
     std::unique_ptr<DetectorBank> db(
-        new DetectorBank(sr, &tone[0], samples, 1, &f, test_bw, 1, 
+        new DetectorBank(sr, sr, &tone[0], blockLen, 1, &f, test_bw, 1, 
                          static_cast<DetectorBank::Features>(
-                            method|DetectorBank::Features::freq_unnormalized|
+                            solver|DetectorBank::Features::freq_unnormalized|
                             DetectorBank::Features::amp_unnormalized
                          ), d, forcingAmplitude)
     );
-    
-    std::unique_ptr<discriminator_t[]> results(new discriminator_t[samples]);
-        
-    db->getZ(results.get(), 1, samples);
-    
-    // find index where |z| is at max
-    parameter_t z_max = 0.0;
-    std::size_t where;
-    for (std::size_t i{0}; i < samples; i++) {
-        if (z_max < std::abs(results[i])) {
-            z_max = std::abs(results[i]);
-            where = i;
+
+    // Run the detector until the greatest |z| in each block has changed
+    // by less than the tolerance over two successive blocks, keeping the
+    // output at which |z| is greatest. The detector keeps its state as
+    // the input buffer is replaced by each block of the tone in turn.
+    discriminator_t z_max {0};
+    parameter_t absMax {0}, prevBlockMax {0};
+    int settled {0};
+    std::size_t samples {0};
+    std::size_t len {0};
+
+    while (samples < maxSamples && settled < 2) {
+        len = std::min(blockLen, maxSamples - samples);
+        generateTone(&tone[0], len, f, samples);
+        db->setInputBuffer(&tone[0], len);
+        db->getZ(results.get(), 1, len);
+        samples += len;
+
+        parameter_t blockMax {0};
+        for (std::size_t i{0}; i < len; i++) {
+            const parameter_t a { std::abs(results[i]) };
+            blockMax = std::max(blockMax, a);
+            if (a > absMax) {
+                absMax = a;
+                z_max = results[i];
+            }
         }
+
+        if (std::abs(blockMax - prevBlockMax) <= tolerance * blockMax)
+            settled++;
+        else
+            settled = 0;
+        prevBlockMax = blockMax;
     }
 
     // (complex) amplitude normalisation factor
-    aScale = 1. / results[where];
+    aScale = 1. / z_max;
 
-    // number of oscillations over which to find eccentricity
-    const std::size_t nOsc {5};
-    // number of samples in nOsc oscillations
-    const std::size_t sOsc {static_cast<std::size_t>(sr * nOsc/f)};
-        
-    // find eccentricity (if orbits aren't circular)
+    // find eccentricity (if orbits aren't circular) over the last
+    // oscillations of the final block
     parameter_t mxim{0.}, mxre{0.};
-    for (std::size_t i{samples-sOsc}; i < samples; i++) {
+    for (std::size_t i{len - std::min(sOsc, len)}; i < len; i++) {
         const discriminator_t z { results[i] * aScale };
         if ( std::abs(z.imag()) > std::abs(mxim) ) mxim = z.imag();
         if ( std::abs(z.real()) > std::abs(mxre) ) mxre = z.real();
@@ -300,59 +293,140 @@ bool AbstractDetector::amplitudeNormalize(const parameter_t forcingAmplitude)
     std::ofstream zf;
     zf.open("/tmp/z.dat", std::ofstream::out | std::ofstream::app);
     zf << "\n\tnormalisation " << aScale.real() << "+j(" << aScale.imag()
-        << "),\n\teccentricity " << iScale << std::endl;
+        << "),\n\teccentricity " << iScale
+        << "\n\tafter " << samples << " samples" << std::endl;
 #   endif
     
+    return samples;
+}
+
+void AbstractDetector::toneResponse(const parameter_t frequency,
+                                    const parameter_t amplitude,
+                                    discriminator_t& A, discriminator_t& B) const
+{
+    // sin(theta n) = (e^{j theta n} - e^{-j theta n}) / 2j
+    const parameter_t theta { 2.*M_PI*frequency/sr };
+    const discriminator_t twoJ { 0, 2 };
+    A =  amplitude * linearResponse(theta) / twoJ;
+    B = -amplitude * linearResponse(-theta) / twoJ;
+}
+
+bool AbstractDetector::analyticSearchNormalize(const parameter_t searchStart,
+                                               const parameter_t searchEnd)
+{
+    nrml = true;
+
+    // Specified detector frequency
+    const parameter_t f_spec { w/(2.0*M_PI) };
+
+    // Greatest steady-state |z| of a detector at the given log frequency
+    // in response to a tone at f_spec. The detector's frequency is
+    // changed to find this, and set once the best is known.
+    auto peak {
+        [&](const parameter_t logFreq) {
+            w = 2.*M_PI*std::exp(logFreq);
+            discriminator_t A, B;
+            toneResponse(f_spec, 1., A, B);
+            return std::abs(A) + std::abs(B);
+        }
+    };
+
+    // Golden-section search, in log frequency, for the greatest response
+    const parameter_t invPhi { (std::sqrt(5.) - 1.) / 2. };
+    const parameter_t start { std::log(searchStart * f_spec) };
+    const parameter_t end { std::log(searchEnd * f_spec) };
+    parameter_t lower { start }, upper { end };
+    parameter_t x1 { upper - invPhi * (upper - lower) };
+    parameter_t x2 { lower + invPhi * (upper - lower) };
+    parameter_t y1 { peak(x1) }, y2 { peak(x2) };
+
+    while (upper - lower > 1e-10) {
+        if (y1 < y2) {
+            lower = x1;
+            x1 = x2;
+            y1 = y2;
+            x2 = lower + invPhi * (upper - lower);
+            y2 = peak(x2);
+        } else {
+            upper = x2;
+            x2 = x1;
+            y2 = y1;
+            x1 = upper - invPhi * (upper - lower);
+            y1 = peak(x1);
+        }
+    }
+
+    // If the response only rises towards either bound, the search
+    // ends there, and the bounds do not span the maximum response
+    const parameter_t best { 0.5 * (lower + upper) };
+    if (peak(best) <= std::max(peak(start), peak(end))) {
+        w = 2.*M_PI*f_spec;
+        return false;
+    }
+
+    w = 2.*M_PI*std::exp(best);
     return true;
 }
 
+void AbstractDetector::analyticAmplitudeNormalize(const parameter_t forcingAmplitude)
+{
+    discriminator_t A, B;
+    toneResponse(w/(2.0*M_PI), forcingAmplitude, A, B);
+
+    // z traces an ellipse, whose semi-major axis |A|+|B| is reached when
+    // the two terms are in phase and whose semi-minor axis is |A|-|B|
+    aScale = 1. / std::polar(std::abs(A) + std::abs(B),
+                             0.5 * (std::arg(A) + std::arg(B)));
+    iScale = (std::abs(A) + std::abs(B)) / (std::abs(A) - std::abs(B));
+}
+
 void AbstractDetector::scaleAmplitude() {
     makeScaleVectors();
-    getScaleValue(w/(2.0*M_PI));
+    // A detector run at a fraction of 44.1kHz or 48kHz is scaled as one
+    // of the same fraction of the sample rate at the full rate
+    getScaleValue(w/(2.0*M_PI) * scaleRate() / sr);
+}
+
+parameter_t AbstractDetector::scaleRate() const {
+    return std::fmod(44100., sr) == 0 ? 44100. : 48000.;
 }
 
     
 void AbstractDetector::makeScaleVectors() {
     // ScaleFreqs and ScaleFactors come from scale_values.inc
     
-    std::string method;
-    
-    // Determine this's numerical method
-    if (typeid(*this) == typeid(CDDetector))
-         method = "CD";
-    else if (typeid(*this) == typeid(RK4Detector))
-        method = "RK4";
-    else
+    // Vectors for each sample rate are in the order rk4_un, rk4_sn,
+    // cd_un, cd_sn, exact_un, exact_sn, si_un, si_sn
+    int index;
+    
+    switch (solver) {
+    case DetectorBank::Features::runge_kutta:
+        index = 0;
+        break;
+    case DetectorBank::Features::central_difference:
+        index = 2;
+        break;
+    case DetectorBank::Features::exact_linear:
+        index = 4;
+        break;
+    case DetectorBank::Features::semi_implicit:
+        index = 6;
+        break;
+    default:
         throw std::runtime_error(
-            "Invalid detector type while attempting amplitude scaling");
-        
-    int offset;
+            "Invalid numerical method while attempting amplitude scaling");
+    }
     
-    if (sr==44100.)
-        offset = 0;
-    else
-        offset = 4;
+    // normalised vectors follow unnormalised ones
+    if (nrml)
+        index++;
     
-    // unnormalised RK4
-    if (method == "RK4" && !nrml) {
-        detScaleFreqs = scaleFreqs[0+offset];
-        detScaleFactors = scaleFactors[0+offset];
-    }
-    // normalised RK4
-    else if (method == "RK4" && nrml) {
-        detScaleFreqs = scaleFreqs[1+offset];
-        detScaleFactors = scaleFactors[1+offset];
-    }
-    // unnormalised CD
-    else if (method == "CD" && !nrml) {
-        detScaleFreqs = scaleFreqs[2+offset];
-        detScaleFactors = scaleFactors[2+offset];
-    }
-    // normalised CD
-    else if (method == "CD" && nrml) {
-        detScaleFreqs = scaleFreqs[3+offset];
-        detScaleFactors = scaleFactors[3+offset];
-    }
+    // 48kHz vectors follow 44.1kHz ones
+    if (scaleRate() != 44100.)
+        index += 8;
+    
+    detScaleFreqs = scaleFreqs[index];
+    detScaleFactors = scaleFactors[index];
 }
 
 void AbstractDetector::getScaleValue(const parameter_t fr) {
@@ -391,7 +465,7 @@ void AbstractDetector::getScaleValue(const parameter_t fr) {
 CDDetector::CDDetector(parameter_t f, parameter_t mu, 
                        parameter_t d, parameter_t sr, 
                        parameter_t detBw, parameter_t gain)
-    : AbstractDetector(f, mu, d, sr, detBw, gain)
+    : AbstractDetector(f, mu, d, sr, detBw, gain, method)
     , zp(0), zpp(0), xp(0)
 {
     b = 0;
@@ -421,16 +495,28 @@ void CDDetector::process(discriminator_t* target,
         };
         
         zpp = zp;
-        zp = *target++ = result;
+        zp = result;
+        *target++ = normalize(result);
         
         xp = *start++;
     }
 }
 
+discriminator_t CDDetector::linearResponse(const parameter_t theta) const
+{
+    // z[n] = (2h((mu + jw) z[n-1] + x[n-1]) + z[n-2]) (1-d)
+    const parameter_t h { 1./sr };
+    const std::complex<parameter_t> c { mu, w };
+    const std::complex<parameter_t> e1 { std::polar(1., -theta) };
+    const parameter_t damp { 1.-d };
+
+    return 2.*h*damp * e1 / (1. - 2.*h*damp * c * e1 - damp * e1*e1);
+}
+
 RK4Detector::RK4Detector(parameter_t f, parameter_t mu, 
                          parameter_t d, parameter_t sr, 
                          parameter_t detBw, parameter_t gain)
-    : AbstractDetector(f, mu, d, sr, detBw, gain)
+    : AbstractDetector(f, mu, d, sr, detBw, gain, method)
     , zp(0), zpp(0), xp(0), xpp(0)
 {
     b = getLyapunov(detBw, gain);
@@ -472,11 +558,174 @@ void RK4Detector::process(discriminator_t* target,
         const std::complex<double> k3 {dzdt(u3, *start)};
             
         zpp = zp;
-        zp = *target++ = (u0 + (k0 + 2.0*k1 + 2.0*k2 + k3)/(3.*sr)) * (1.-d);
+        zp = (u0 + (k0 + 2.0*k1 + 2.0*k2 + k3)/(3.*sr)) * (1.-d);
+        *target++ = normalize(zp);
 
         xpp = xp;
         xp = *start++;
     }
 }
 
+discriminator_t RK4Detector::linearResponse(const parameter_t theta) const
+{
+    // Each step advances z[n-2] to z[n] using x[n-2], x[n-1] and x[n],
+    // as in process(), so with b = 0 it is linear in these four values
+    const parameter_t h { 1./sr };
+    const std::complex<parameter_t> c { mu, w };
+    auto step {
+        [&](const std::complex<parameter_t> u0, const parameter_t x0,
+            const parameter_t x1, const parameter_t x2) {
+            const std::complex<parameter_t> k0 { c * u0 + x0 };
+            const std::complex<parameter_t> k1 { c * (u0 + k0*h) + x1 };
+            const std::complex<parameter_t> k2 { c * (u0 + k1*h) + x1 };
+            const std::complex<parameter_t> k3 { c * (u0 + k2*2.*h) + x2 };
+            return (u0 + (k0 + 2.*k1 + 2.*k2 + k3)*h/3.) * (1.-d);
+        }
+    };
+
+    const std::complex<parameter_t> e1 { std::polar(1., -theta) };
+    return (step(0, 1, 0, 0) * e1*e1 + step(0, 0, 1, 0) * e1 + step(0, 0, 0, 1)) /
+           (1. - step(1, 0, 0, 0) * e1*e1);
+}
+
+ExactDetector::ExactDetector(parameter_t f, parameter_t mu, 
+                             parameter_t d, parameter_t sr, 
+                             parameter_t detBw, parameter_t gain)
+    : AbstractDetector(f, mu, d, sr, detBw, gain, method)
+    , zp(0), xp(0)
+{
+    b = 0;
+}
+
+ExactDetector::~ExactDetector()
+{
+}
+
+void ExactDetector::reset()
+{
+    zp = 0;
+    xp = 0;
+}
+
+void ExactDetector::coefficients(std::complex<parameter_t>& a,
+                                 std::complex<parameter_t>& b0,
+                                 std::complex<parameter_t>& b1) const
+{
+    const parameter_t h { 1./sr };
+    const std::complex<parameter_t> q { (mu + std::complex<parameter_t>(0,1) * w) * h };
+    const std::complex<parameter_t> e { std::exp(q) };
+    
+    // i0 = (e^q - 1)/q and i1 = (e^q - 1 - q)/q^2. For small q the
+    // subtractions cancel badly, so sum the Taylor series instead.
+    std::complex<parameter_t> i0, i1;
+    if (std::abs(q) < 0.1) {
+        std::complex<parameter_t> term {1};
+        i0 = 0;
+        i1 = 0;
+        for (int k{0}; k < 12; k++) {
+            // term = q^k/(k+1)!
+            i0 += term;
+            i1 += term / static_cast<parameter_t>(k+2);
+            term *= q / static_cast<parameter_t>(k+2);
+        }
+    } else {
+        i0 = (e - 1.) / q;
+        i1 = (e - 1. - q) / (q*q);
+    }
+    
+    const parameter_t damp { std::sqrt(1.-d) };
+    a  = e * damp;
+    b1 = i1 * h * damp;
+    b0 = i0 * h * damp - b1;
+}
+
+void ExactDetector::process(discriminator_t* target,
+                            const inputSample_t* start, const std::size_t count)
+{
+    std::complex<parameter_t> a, b0, b1;
+    coefficients(a, b0, b1);
+    
+    for (std::size_t i{0}; i < count; i++) {
+        const parameter_t x { *start++ };
+        zp = a * zp + b0 * static_cast<parameter_t>(xp) + b1 * x;
+        *target++ = normalize(zp);
+        
+        xp = x;
+    }
+}
+
+discriminator_t ExactDetector::linearResponse(const parameter_t theta) const
+{
+    std::complex<parameter_t> a, b0, b1;
+    coefficients(a, b0, b1);
+
+    const std::complex<parameter_t> e1 { std::polar(1., -theta) };
+    return (b0 * e1 + b1) / (1. - a * e1);
+}
+
+SemiImplicitDetector::SemiImplicitDetector(parameter_t f, parameter_t mu, 
+                                           parameter_t d, parameter_t sr, 
+                                           parameter_t detBw, parameter_t gain)
+    : AbstractDetector(f, mu, d, sr, detBw, gain, method)
+    , zp(0), zpp(0), xp(0)
+{
+    b = getLyapunov(detBw, gain);
+}
+
+SemiImplicitDetector::~SemiImplicitDetector()
+{
+}
+
+void SemiImplicitDetector::reset()
+{
+    zp = 0;
+    zpp = 0;
+    xp = 0;
+}
+
+void SemiImplicitDetector::coefficients(std::complex<parameter_t>& a,
+                                        std::complex<parameter_t>& c) const
+{
+    const parameter_t h { 1./sr };
+    // Prewarp the frequency to undo the compression of the trapezium rule
+    const parameter_t warped { 2.*sr * std::tan(w/(2.*sr)) };
+    const std::complex<parameter_t> hp2 {
+        (mu + std::complex<parameter_t>(0,1) * warped) * h/2.
+    };
+    const parameter_t damp { std::sqrt(1.-d) };
+    
+    a = (1. + hp2) / (1. - hp2) * damp;
+    c = h / (1. - hp2) * damp;
+}
+
+void SemiImplicitDetector::process(discriminator_t* target,
+                                   const inputSample_t* start, const std::size_t count)
+{
+    std::complex<parameter_t> a, c;
+    coefficients(a, c);
+    
+    for (std::size_t i{0}; i < count; i++) {
+        const parameter_t x { *start++ };
+        const std::complex<parameter_t> forcing {
+            1.5 * b * std::norm(zp) * zp - 0.5 * b * std::norm(zpp) * zpp
+            + 0.5 * (x + static_cast<parameter_t>(xp))
+        };
+        zpp = zp;
+        zp = a * zp + c * forcing;
+        *target++ = normalize(zp);
+        
+        xp = x;
+    }
+}
+
+discriminator_t SemiImplicitDetector::linearResponse(const parameter_t theta) const
+{
+    // With b = 0 the forcing is the mean of x[n] and x[n-1]
+    std::complex<parameter_t> a, c;
+    coefficients(a, c);
+
+    const std::complex<parameter_t> e1 { std::polar(1., -theta) };
+    return 0.5 * c * (1. + e1) / (1. - a * e1);
+}
+
 #include "scale_values.inc"
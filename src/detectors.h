@@ -13,6 +13,7 @@
 
 #include "detectorbank.h"
 #include "detectortypes.h"
+#include "normalisationcache.h"
 
 /*!
  * Base class for detectors using different numerical methods.
@@ -28,17 +29,19 @@ public:
      * \param sr Sample rate of input audio (should be 44.1kHz or 48kHz)
      * \param detBw Detector bandwidth (Hz)
      * \param gain Detector gain
+     * \param solver Numerical method of the derived class
      */
     AbstractDetector(parameter_t f, parameter_t mu, 
                      parameter_t d, parameter_t sr, 
-                     parameter_t detBw, parameter_t gain);
+                     parameter_t detBw, parameter_t gain,
+                     DetectorBank::Features solver);
                     
     virtual ~AbstractDetector();
     //! Process audio using the numerical method appropriate to the derived class.
     /*!
-     * The derived class's process() method is called and if
-     * amplitude normalisation is required, the predetermined 
-     * gain and stiffness constant is applied to the result.
+     * The derived class's process() method is called. If amplitude
+     * normalisation is required, the predetermined gain and stiffness
+     * constant are applied by process() as each output sample is written.
      * 
      * \param target Pointer to output array. This should have the correct 
      * dimensions for your desired detector bank: height = number of 
@@ -53,19 +56,21 @@ public:
      * Normalise the detector frequency using an iterative scheme. 
      * The lower and upper bounds of the search must be respectively 
      * lower and higher than the actual characteristic frequency of 
-     * the detector. The search iterates by moving the worst performing 
-     * bounding frequency half way towards the mean of the two current 
-     * bounds until the maximum number of iterations or is exceeded or 
-     * the specified accuracy is achieved (see maxNormIterations and 
-     * normConverged).
+     * the detector. On each round a batch of searchBatch test detectors,
+     * equally spaced in log frequency across the current bounds, is run
+     * at once, and the bounds are narrowed to the neighbours of the test
+     * detector with the greatest response. This is repeated until the
+     * maximum number of rounds is exceeded or the specified accuracy is
+     * achieved (see maxNormIterations and normConverged), and the
+     * frequency is then refined by fitting a parabola to the best
+     * response and its neighbours.
      * 
      * \param searchStart Lower bound of search (ratio of specified f0)
      * \param searchEnd Upper bound of search (ratio of specified f0)
      * \param toneDuration Length constant test tone to be generaated
-     * \throw std::string Invalid detector type while attempting
-     *                    search-normalisation
-     * \throw std::string Searching for normalised charactersitc frequency:
-     *                    test range does not span maximum response.
+     * \param forcing_amplitude Gain applied to the test tone
+     * \return false, leaving the frequency unchanged, if the test range
+     *         does not span the maximum response
      */
     bool searchNormalize(parameter_t searchStart,
                          parameter_t searchEnd,
@@ -76,24 +81,85 @@ public:
      * detector response. These can then be used to normalise the detector's 
      * amplitude response to the range 0-1.
      * 
+     * A tone at the detector's frequency is run through a copy of the
+     * detector in blocks of 0.2s (or five oscillations, if longer) until
+     * the largest \f$|z|\f$ in a block has changed by no more than the
+     * tolerance over two successive blocks, or for at most 60s. The
+     * eccentricity is measured over the last five oscillations.
+     * 
      *  \param forcingAmplitude Gain that was applied to the input signal
-     *  \returns true
-     *  \throw std::string Invalid detector type while attempting amplitude 
-     *                     normalization
+     *  \param tolerance Relative change in the peak response of successive
+     *         blocks below which the response is taken to have settled
+     *  \returns Number of samples of the tone used
      */
-    bool amplitudeNormalize(const parameter_t forcing_amplitude);
+    std::size_t amplitudeNormalize(const parameter_t forcing_amplitude,
+                                   const parameter_t tolerance = 1e-5);
+    
+    /*! Whether the detector is linear (its first Lyapunov coefficient
+     *  is zero), so that its normalisation may be calculated by
+     *  analyticSearchNormalize() and analyticAmplitudeNormalize()
+     *  rather than by running test tones */
+    bool isLinear() const { return b == 0; }
+
+    /*! Equivalent of searchNormalize() for a linear detector.
+     * 
+     * The steady-state response of each candidate frequency to a tone at
+     * the specified frequency is found from linearResponse(), and the
+     * frequency giving the greatest response is found by golden-section
+     * search to well within normConverged.
+     * 
+     * \param searchStart Lower bound of search (ratio of specified f0)
+     * \param searchEnd Upper bound of search (ratio of specified f0)
+     * \return false, leaving the frequency unchanged, if the test range
+     *         does not span the maximum response
+     */
+    bool analyticSearchNormalize(const parameter_t searchStart,
+                                 const parameter_t searchEnd);
+
+    /*! Equivalent of amplitudeNormalize() for a linear detector.
+     * 
+     * The steady-state output in response to a sine tone traces an
+     * ellipse, whose greatest value gives aScale and whose axes give
+     * iScale, so these are found from linearResponse() directly.
+     * 
+     * \param forcingAmplitude Gain that was applied to the input signal
+     */
+    void analyticAmplitudeNormalize(const parameter_t forcingAmplitude);
     
     /*! Calculate amplitude scale factor */
     void scaleAmplitude();
+
+    /*! Get the results of frequency and amplitude normalisation
+     * \return Adjusted frequency and amplitude scale factors */
+    NormalisationCache::Value getNormalisation() const
+    {
+        return NormalisationCache::Value { w, aScale, iScale };
+    }
+
+    /*! Restore the results of an earlier normalisation, in place of
+     *  calling searchNormalize() and amplitudeNormalize()
+     * \param value Result from getNormalisation()
+     * \param searched Whether the result includes search normalisation */
+    void setNormalisation(const NormalisationCache::Value& value,
+                          const bool searched)
+    {
+        w = value.w;
+        aScale = value.aScale;
+        iScale = value.iScale;
+        nrml = searched;
+    }
     
     /*! Generate a sine tone
      *  \param tone Array for output tone
      *  \param duration Tone duration (in samples)
      *  \param frequency Frequency at which to generate tone (Hz)
+     *  \param start Sample number of the first sample, so that a long
+     *         tone may be generated in parts
      */
     void generateTone(inputSample_t* tone, 
                       const std::size_t duration,
-                      const parameter_t frequency);
+                      const parameter_t frequency,
+                      const std::size_t start = 0);
     
     // ACCESS FUNCTIONS
     
@@ -111,12 +177,46 @@ public:
     
 protected:
     /*!
-     * This method gets overridden in derived classes
-     * to produce an unnormalised version of the required output.
+     * This method gets overridden in derived classes to produce the
+     * required output. Each sample must be passed through normalize()
+     * before being written to target.
      */
     virtual void process(discriminator_t* target,
                          const inputSample_t* start, std::size_t count) = 0;
+
+    /*!
+     * Steady-state gain of the detector's recurrence when it is linear
+     * (see isLinear()): the output in response to the input
+     * \f$e^{j\theta n}\f$ is \f$H(\theta)e^{j\theta n}\f$, including
+     * damping but not the normalisation applied to the output.
+     * Overridden in derived classes.
+     * \param theta Frequency of the input (radians per sample)
+     * \return \f$H(\theta)\f$
+     */
+    virtual discriminator_t linearResponse(const parameter_t theta) const = 0;
+
+    /*!
+     * Steady-state output of a linear detector in response to a sine
+     * tone, \f$z[n] = Ae^{j\theta n} + Be^{-j\theta n}\f$.
+     * \param frequency Frequency of the tone (Hz)
+     * \param amplitude Amplitude of the tone
+     * \param A Set to the coefficient of the positive frequency
+     * \param B Set to the coefficient of the negative frequency
+     */
+    void toneResponse(const parameter_t frequency, const parameter_t amplitude,
+                      discriminator_t& A, discriminator_t& B) const;
                          
+
+    /*! Apply the amplitude normalisation factor and eccentricity
+     *  correction to a raw detector output.
+     * \param z Unnormalised detector output
+     * \return Normalised detector output
+     */
+    discriminator_t normalize(const discriminator_t z) const
+    {
+        const discriminator_t scaled { z * aScale };
+        return discriminator_t(scaled.real(), scaled.imag() * iScale);
+    }
      
     /*! Find the first Lyapunov coefficient required for a given
      *  bandwidth, with a given forcing amplitude.
@@ -164,15 +264,30 @@ protected:
     template <class Archive> void load(Archive& archive)
     {
         //std::cout << "Starting to load an AbstractDetector\n";
+        const NormalisationCache::Value value { loadNormalisation(archive) };
+        w = value.w;
+        aScale = value.aScale;
+        iScale = value.iScale;
+    }
+    /*!
+     * Read the properties written by save() without a detector, so that
+     * the detector may be made afterwards and given them with setNormalisation()
+     * \param archive The archive from which properties are read.
+     */
+    template <class Archive> static NormalisationCache::Value loadNormalisation(Archive& archive)
+    {
+        NormalisationCache::Value value;
         archive.startNode();
-        archive(cereal::make_nvp("w_adjusted", w),
-                CEREAL_NVP(aScale),
-                CEREAL_NVP(iScale)
+        archive(cereal::make_nvp("w_adjusted", value.w),
+                cereal::make_nvp("aScale", value.aScale),
+                cereal::make_nvp("iScale", value.iScale)
         );
 
         archive.finishNode();
+        return value;
     }
     
+    DetectorBank::Features const solver; /*!< Numerical method */
     parameter_t w;               /*!< Characteristic frequency */
     parameter_t const mu;        /*!< Distance from the bifurcation point */
     parameter_t const d;         /*!< Detector damping factor */
@@ -185,9 +300,12 @@ protected:
     discriminator_t scale;       /*!< Detector's scale factor */
     bool nrml { false };         /*!< If search normalisation has been applied */
      
-    /*! The maximum number of iterations to find best response
+    /*! The maximum number of rounds to find best response
      *  during search_normalization */
     static constexpr int maxNormIterations { 100 };
+    /*! Number of test detectors run together in each round of
+     *  search_normalization; one batch of DetectorBatch::lanes */
+    static constexpr std::size_t searchBatch { 8 };
     /*! Ratio of discovered frequency to specification frequency
      *  to be considered "close enough" during seach_normalization.
      *  1.0057929410678534 = 2^(1/120) = 10 cents;
@@ -198,13 +316,17 @@ protected:
     /*! Make freq and factor vectors for given method and normalisation */
     void makeScaleVectors();
     
+    /*! Sample rate of the scale vectors used: 44.1kHz for it and its
+     *  fractions, otherwise 48kHz */
+    parameter_t scaleRate() const;
+    
     /*! Get a scale value for a given frequency*/
     void getScaleValue(const parameter_t fr);
     
     std::vector<parameter_t> detScaleFreqs;
     std::vector<discriminator_t> detScaleFactors;
-    static const std::array<std::vector<parameter_t>, 8> scaleFreqs;
-    static const std::array<std::vector<discriminator_t>, 8> scaleFactors;
+    static const std::array<std::vector<parameter_t>, 16> scaleFreqs;
+    static const std::array<std::vector<discriminator_t>, 16> scaleFactors;
 };
 
 /*! 
@@ -221,6 +343,11 @@ protected:
  */
 class CDDetector : public AbstractDetector {
 public:
+    /*! The numerical method implemented by this class */
+    static constexpr DetectorBank::Features method {
+        DetectorBank::Features::central_difference
+    };
+
     /*!
      * \param f Detector centre frequency (Hz)
      * \param mu Detector control parameter. (Setting mu = 0 positions the 
@@ -251,8 +378,17 @@ public:
     virtual void process(discriminator_t* target,
                          const inputSample_t* start,
                          const std::size_t count) override;
+
+    /*! Steady-state gain of the central difference recurrence with \f$b = 0\f$.
+     *  See AbstractDetector::linearResponse(). */
+    virtual discriminator_t linearResponse(const parameter_t theta) const override;
                          
 private:
+    /*! The batched and scanned solvers read and write the detector
+     *  state directly */
+    template <class> friend class DetectorBatch;
+    template <class> friend class DetectorScan;
+
     std::complex<parameter_t> zp;        //!< previous z value
     std::complex<parameter_t> zpp;       //!< z value two samples ago
     inputSample_t xp;                    //!< previous audio input sample
@@ -290,6 +426,11 @@ private:
  */
 class RK4Detector : public AbstractDetector {
 public:
+    /*! The numerical method implemented by this class */
+    static constexpr DetectorBank::Features method {
+        DetectorBank::Features::runge_kutta
+    };
+
     /*!
      * \param f Detector centre frequency (Hz)
      * \param mu Detector control parameter. (Setting mu = 0 positions the 
@@ -319,11 +460,200 @@ public:
     virtual void process(discriminator_t* target,
                          const inputSample_t* start,
                          const std::size_t count) override;
+
+    /*! Steady-state gain of the Runge-Kutta recurrence with \f$b = 0\f$.
+     *  See AbstractDetector::linearResponse(). */
+    virtual discriminator_t linearResponse(const parameter_t theta) const override;
 private:
+    /*! The batched and scanned solvers read and write the detector
+     *  state directly */
+    template <class> friend class DetectorBatch;
+    template <class> friend class DetectorScan;
+
     std::complex<parameter_t> zp;        //!< previous z value
     std::complex<parameter_t> zpp;       //!< z value two samples ago
     inputSample_t xp;                    //!< previous audio input sample
     inputSample_t xpp;                   //!< audio input sample two samples ago
 };
 
+/*!
+ * Step the linearised detector exactly.
+ * 
+ * When \f$b = 0\f$ the Hopf bifurcation
+ * \f[\dot z=(\mu+j\omega_0)z + X\f]
+ * is a linear ordinary differential equation which can be integrated
+ * over one sample period \f$\delta\f$ in closed form. With
+ * \f$p = \mu+j\omega_0\f$ and the input treated as varying linearly
+ * between samples,
+ * 
+ * \f[
+ * z[n] = e^{p\delta}z[n-1] + \beta_0X[n-1] + \beta_1X[n]
+ * \f]
+ * 
+ * where
+ * 
+ * \f{eqnarray*}
+ * \beta_1 & = & \frac{e^{p\delta} - 1 - p\delta}{p^2\delta} \\
+ * \beta_0 & = & \frac{e^{p\delta} - 1}p - \beta_1.
+ * \f}
+ * 
+ * The only error is that of the interpolation of the input, so the
+ * detector responds at its characteristic frequency all the way up to
+ * the Nyquist frequency, at the cost of one complex multiply-add per
+ * sample. The damping is applied per sample as
+ * \f$\sqrt{1-d}\f$, which matches the decay of the other methods.
+ * This method can only be used for minimum-bandwidth detectors.
+ */
+class ExactDetector : public AbstractDetector {
+public:
+    /*! The numerical method implemented by this class */
+    static constexpr DetectorBank::Features method {
+        DetectorBank::Features::exact_linear
+    };
+
+    /*!
+     * \param f Detector centre frequency (Hz)
+     * \param mu Detector control parameter. (Setting mu = 0 positions the 
+     * system at the bifurcation point)
+     * \param d Detector damping ratio
+     * \param sr Sample rate of input audio
+     * \param detBw Detector bandwidth
+     * \param gain Detector gain
+     */
+    ExactDetector(const parameter_t f, const parameter_t mu, 
+                  const parameter_t d, const parameter_t sr, 
+                  const parameter_t detBw, const parameter_t gain);
+    virtual ~ExactDetector();
+    /*! Reset internal values to 0 
+     *  This is invoked when Detect.seek() is called.
+     */
+    virtual void reset();
+    /*! Method to process audio using the exact discretisation.
+     *  Serves the scalar processAudio() path; DetectorBank runs its
+     *  channels through DetectorBatch, which repeats this step in lanes.
+     * \param target Output array. This should have the correct 
+     * dimensions for your desired detector bank: height = number of 
+     * detectors, length = length of audio input.
+     * \param start Current audio sample
+     * \param count Number of frames to process
+     */
+
+    virtual void process(discriminator_t* target,
+                         const inputSample_t* start,
+                         const std::size_t count) override;
+
+    /*! Steady-state gain of the exact recurrence with \f$b = 0\f$.
+     *  See AbstractDetector::linearResponse(). */
+    virtual discriminator_t linearResponse(const parameter_t theta) const override;
+private:
+    /*! The batched and scanned solvers read and write the detector
+     *  state directly */
+    template <class> friend class DetectorBatch;
+    template <class> friend class DetectorScan;
+
+    /*! Find the per-sample coefficients of the discretisation, including
+     *  the damping. These depend on w, which may be changed by search
+     *  normalisation, so they are recalculated by each call to process().
+     * \param a Multiplier of the previous output
+     * \param b0 Multiplier of the previous input sample
+     * \param b1 Multiplier of the current input sample
+     */
+    void coefficients(std::complex<parameter_t>& a,
+                      std::complex<parameter_t>& b0,
+                      std::complex<parameter_t>& b1) const;
+
+    std::complex<parameter_t> zp;        //!< previous z value
+    inputSample_t xp;                    //!< previous audio input sample
+};
+
+/*!
+ * Use a semi-implicit second order method to calculate the output.
+ * 
+ * The linear part of the Hopf bifurcation
+ * \f[\dot z=(\mu+j\omega_0)z + b|z|^2z + X\f]
+ * is integrated with the trapezium rule (Crank-Nicolson), which is
+ * unconditionally stable and neither grows nor decays an undriven
+ * oscillation, and the nonlinear term is extrapolated from the previous
+ * two outputs (second order Adams-Bashforth). With
+ * \f$N[n] = b|z[n]|^2z[n]\f$ and \f$\delta\f$ the time step between
+ * samples,
+ * 
+ * \f[
+ * \Big(1-\frac{p\delta}2\Big)z[n] = \Big(1+\frac{p\delta}2\Big)z[n-1]
+ * + \delta\Big(\frac32N[n-1] - \frac12N[n-2]\Big)
+ * + \frac\delta2\big(X[n] + X[n-1]\big)
+ * \f]
+ * 
+ * where \f$p = \mu+j\omega\f$. The trapezium rule compresses
+ * frequencies, so \f$\omega\f$ is prewarped,
+ * \f$\omega = \frac2\delta\tan\frac{\omega_0\delta}2\f$, to place
+ * the response of the linear part exactly at \f$\omega_0\f$.
+ * The damping is applied per sample as \f$\sqrt{1-d}\f$.
+ * 
+ * Each sample costs one evaluation of the nonlinear term rather than the
+ * four function evaluations of RK4Detector, and, unlike
+ * CDDetector and ExactDetector, any bandwidth may be used.
+ */
+class SemiImplicitDetector : public AbstractDetector {
+public:
+    /*! The numerical method implemented by this class */
+    static constexpr DetectorBank::Features method {
+        DetectorBank::Features::semi_implicit
+    };
+
+    /*!
+     * \param f Detector centre frequency (Hz)
+     * \param mu Detector control parameter. (Setting mu = 0 positions the 
+     * system at the bifurcation point)
+     * \param d Detector damping ratio
+     * \param sr Sample rate of input audio
+     * \param detBw Detector bandwidth
+     * \param gain Detector gain
+     */
+    SemiImplicitDetector(const parameter_t f, const parameter_t mu, 
+                         const parameter_t d, const parameter_t sr, 
+                         const parameter_t detBw, const parameter_t gain);
+    virtual ~SemiImplicitDetector();
+    /*! Reset internal values to 0 
+     *  This is invoked when Detect.seek() is called.
+     */
+    virtual void reset();
+    /*! Method to process audio using the semi-implicit method.
+     *  Serves the scalar processAudio() path; DetectorBank runs its
+     *  channels through DetectorBatch, which repeats this step in lanes.
+     * \param target Output array. This should have the correct 
+     * dimensions for your desired detector bank: height = number of 
+     * detectors, length = length of audio input.
+     * \param start Current audio sample
+     * \param count Number of frames to process
+     */
+
+    virtual void process(discriminator_t* target,
+                         const inputSample_t* start,
+                         const std::size_t count) override;
+
+    /*! Steady-state gain of the semi-implicit recurrence with \f$b = 0\f$.
+     *  See AbstractDetector::linearResponse(). */
+    virtual discriminator_t linearResponse(const parameter_t theta) const override;
+private:
+    /*! The batched and scanned solvers read and write the detector
+     *  state directly */
+    template <class> friend class DetectorBatch;
+    template <class> friend class DetectorScan;
+
+    /*! Find the per-sample coefficients of the method, including the
+     *  damping. These depend on w, which may be changed by search
+     *  normalisation, so they are recalculated by each call to process().
+     * \param a Multiplier of the previous output
+     * \param c Multiplier of the forcing (the extrapolated nonlinear
+     *           term plus the mean of the current and previous inputs)
+     */
+    void coefficients(std::complex<parameter_t>& a,
+                      std::complex<parameter_t>& c) const;
+
+    std::complex<parameter_t> zp;        //!< previous z value
+    std::complex<parameter_t> zpp;       //!< z value two samples ago
+    inputSample_t xp;                    //!< previous audio input sample
+};
+
 #endif
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+
+#include "detectorscan.h"
+#include "detectors.h"
+
+template <class Solver>
+DetectorScan<Solver>::DetectorScan(AbstractDetector* detector,
+                                   const inputSample_t* source,
+                                   const std::size_t count,
+                                   const std::size_t blocks,
+                                   complex_t (*states)[2],
+                                   const std::size_t hop,
+                                   const parameter_t gain)
+    : detector(static_cast<Solver*>(detector))
+    , source(source)
+    , count(count)
+    , blocks(blocks)
+    , hop(hop)
+    , gain(gain)
+    , b0(0), b1(0), b2(0)
+    , x2(0)
+    , states(states)
+{
+    load();
+}
+
+template <class Solver>
+void DetectorScan<Solver>::runBlock(const std::size_t k)
+{
+    const std::ptrdiff_t start ( blockStart(k) ), end ( blockStart(k+1) );
+    complex_t zn1 {0}, zn2 {0};
+    parameter_t xn1 {x(start-1)}, xn2 {x(start-2)};
+
+    for (std::ptrdiff_t n {start}; n < end; n++) {
+        const parameter_t xn {inputSample_t(gain * source[n])};
+        const complex_t z { a1*zn1 + a2*zn2 + b0*xn + b1*xn1 + b2*xn2 };
+        zn2 = zn1;
+        zn1 = z;
+        xn2 = xn1;
+        xn1 = xn;
+    }
+    states[k][0] = zn1;
+    states[k][1] = zn2;
+}
+
+template <class Solver>
+void DetectorScan<Solver>::propagate()
+{
+    complex_t s[2] {z1, z2};
+
+    for (std::size_t k {0}; k < blocks; k++) {
+        const complex_t input[2] {states[k][0], states[k][1]};
+        states[k][0] = s[0];
+        states[k][1] = s[1];
+        if (k+1 == blocks)
+            break;
+
+        // M^L, with M = [a1 a2; 1 0], by repeated squaring
+        complex_t p[2][2] {{1, 0}, {0, 1}};
+        complex_t m[2][2] {{a1, a2}, {1, 0}};
+        for (std::size_t l { blockStart(k+1) - blockStart(k) }; l; l >>= 1) {
+            if (l & 1) {
+                const complex_t q[2][2] {
+                    {p[0][0]*m[0][0] + p[0][1]*m[1][0], p[0][0]*m[0][1] + p[0][1]*m[1][1]},
+                    {p[1][0]*m[0][0] + p[1][1]*m[1][0], p[1][0]*m[0][1] + p[1][1]*m[1][1]}
+                };
+                std::copy(&q[0][0], &q[0][0]+4, &p[0][0]);
+            }
+            const complex_t q[2][2] {
+                {m[0][0]*m[0][0] + m[0][1]*m[1][0], m[0][0]*m[0][1] + m[0][1]*m[1][1]},
+                {m[1][0]*m[0][0] + m[1][1]*m[1][0], m[1][0]*m[0][1] + m[1][1]*m[1][1]}
+            };
+            std::copy(&q[0][0], &q[0][0]+4, &m[0][0]);
+        }
+
+        const complex_t next[2] {
+            p[0][0]*s[0] + p[0][1]*s[1] + input[0],
+            p[1][0]*s[0] + p[1][1]*s[1] + input[1]
+        };
+        s[0] = next[0];
+        s[1] = next[1];
+    }
+}
+
+template <class Solver>
+template <class Write>
+void DetectorScan<Solver>::finishBlock(const std::size_t k, Write write)
+{
+    const std::ptrdiff_t start ( blockStart(k) ), end ( blockStart(k+1) );
+    complex_t zn1 {states[k][0]}, zn2 {states[k][1]};
+    parameter_t xn1 {x(start-1)}, xn2 {x(start-2)};
+
+    for (std::ptrdiff_t n {start}; n < end; n++) {
+        const parameter_t xn {inputSample_t(gain * source[n])};
+        const complex_t z { a1*zn1 + a2*zn2 + b0*xn + b1*xn1 + b2*xn2 };
+        zn2 = zn1;
+        zn1 = z;
+        xn2 = xn1;
+        xn1 = xn;
+        write(n, detector->normalize(z));
+    }
+
+    if (k+1 == blocks)
+        store(zn1, zn2);
+}
+
+template <class Solver>
+template <typename T>
+void DetectorScan<Solver>::writeBlock(const std::size_t k, std::complex<T>* target)
+{
+    std::size_t phase {0};
+    finishBlock(k, [&](const std::ptrdiff_t n, const complex_t& z) {
+                       if (phase == 0)
+                           target[n/hop] = std::complex<T>(z);
+                       if (++phase == hop)
+                           phase = 0;
+                   });
+}
+
+template <class Solver>
+template <typename T>
+T DetectorScan<Solver>::writeAbsBlock(const std::size_t k, T* target,
+                                     const DetectorBank::Pooling pooling)
+{
+    const std::ptrdiff_t end ( blockStart(k+1) );
+    T mx {0}, acc {0};
+    std::size_t phase {0};
+    finishBlock(k, [&](const std::ptrdiff_t n, const complex_t& z) {
+                       const std::complex<T> zt { z };
+                       const T p { zt.real()*zt.real() + zt.imag()*zt.imag() };
+                       if (pooling == DetectorBank::mean_power)
+                           acc += p;
+                       else
+                           acc = std::max(acc, p);
+
+                       if (++phase == hop || n+1 == end) {
+                           const T v {
+                               pooling == DetectorBank::mean_power ? acc/phase
+                                                                   : std::sqrt(acc)
+                           };
+                           target[n/hop] = v;
+                           mx = std::max(mx, v);
+                           acc = 0;
+                           phase = 0;
+                       }
+                   });
+    return mx;
+}
+
+// Central difference:
+//   z[n] = (1-d)((mu+jw)z[n-1]*2/sr + x[n-1]*2/sr + z[n-2])
+
+template <>
+bool DetectorScan<CDDetector>::linear(const AbstractDetector* detector)
+{
+    return static_cast<const CDDetector*>(detector)->b == 0;
+}
+
+template <>
+void DetectorScan<CDDetector>::load()
+{
+    const parameter_t damp { 1.-detector->d };
+    const parameter_t twoH { 2./detector->sr };
+    a1 = (detector->mu + complex_t(0,1) * detector->w) * twoH * damp;
+    a2 = damp;
+    b1 = twoH * damp;
+    z1 = detector->zp;
+    z2 = detector->zpp;
+    x1 = detector->xp;
+}
+
+template <>
+void DetectorScan<CDDetector>::store(const complex_t& zn1, const complex_t& zn2)
+{
+    detector->zp  = zn1;
+    detector->zpp = zn2;
+    detector->xp  = x(count-1);
+}
+
+// Fourth order Runge-Kutta:
+//   z[n] = a2 z[n-2] + b2 x[n-2] + b1 x[n-1] + b0 x[n],
+// the coefficients being found by applying one step to each term alone
+
+template <>
+bool DetectorScan<RK4Detector>::linear(const AbstractDetector* detector)
+{
+    return static_cast<const RK4Detector*>(detector)->b == 0;
+}
+
+template <>
+void DetectorScan<RK4Detector>::load()
+{
+    const complex_t p { detector->mu + complex_t(0,1) * detector->w };
+    const parameter_t sr { detector->sr };
+    const parameter_t damp { 1.-detector->d };
+
+    // See RK4Detector::process()
+    auto step = [&] (const complex_t u0, const parameter_t xpp,
+                     const parameter_t xp, const parameter_t x)
+    {
+        const complex_t k0 {p*u0 + xpp};
+        const complex_t u1 {u0 + k0/sr};
+        const complex_t k1 {p*u1 + xp};
+        const complex_t u2 {u0 + k1/sr};
+        const complex_t k2 {p*u2 + xp};
+        const complex_t u3 {u0 + k2 * 2.0/sr};
+        const complex_t k3 {p*u3 + x};
+        return (u0 + (k0 + 2.0*k1 + 2.0*k2 + k3)/(3.*sr)) * damp;
+    };
+
+    a1 = 0;
+    a2 = step(1, 0, 0, 0);
+    b2 = step(0, 1, 0, 0);
+    b1 = step(0, 0, 1, 0);
+    b0 = step(0, 0, 0, 1);
+    z1 = detector->zp;
+    z2 = detector->zpp;
+    x1 = detector->xp;
+    x2 = detector->xpp;
+}
+
+template <>
+void DetectorScan<RK4Detector>::store(const complex_t& zn1, const complex_t& zn2)
+{
+    detector->zp  = zn1;
+    detector->zpp = zn2;
+    detector->xp  = x(count-1);
+    detector->xpp = x(count-2);
+}
+
+// Exact discretisation:
+//   z[n] = a z[n-1] + b0 x[n-1] + b1 x[n]
+
+template <>
+bool DetectorScan<ExactDetector>::linear(const AbstractDetector*)
+{
+    return true;
+}
+
+template <>
+void DetectorScan<ExactDetector>::load()
+{
+    detector->coefficients(a1, b1, b0);
+    a2 = 0;
+    z1 = detector->zp;
+    z2 = 0;
+    x1 = detector->xp;
+}
+
+template <>
+void DetectorScan<ExactDetector>::store(const complex_t& zn1, const complex_t&)
+{
+    detector->zp = zn1;
+    detector->xp = x(count-1);
+}
+
+// Semi-implicit, when b == 0:
+//   z[n] = a z[n-1] + c/2 x[n] + c/2 x[n-1]
+
+template <>
+bool DetectorScan<SemiImplicitDetector>::linear(const AbstractDetector* detector)
+{
+    return static_cast<const SemiImplicitDetector*>(detector)->b == 0;
+}
+
+template <>
+void DetectorScan<SemiImplicitDetector>::load()
+{
+    complex_t c;
+    detector->coefficients(a1, c);
+    a2 = 0;
+    b0 = b1 = 0.5 * c;
+    z1 = detector->zp;
+    z2 = detector->zpp;
+    x1 = detector->xp;
+}
+
+template <>
+void DetectorScan<SemiImplicitDetector>::store(const complex_t& zn1, const complex_t& zn2)
+{
+    detector->zp  = zn1;
+    detector->zpp = zn2;
+    detector->xp  = x(count-1);
+}
+
+template class DetectorScan<CDDetector>;
+template class DetectorScan<RK4Detector>;
+template class DetectorScan<ExactDetector>;
+template class DetectorScan<SemiImplicitDetector>;
+
+template void DetectorScan<CDDetector>::writeBlock<double>(
+    const std::size_t, std::complex<double>*);
+template void DetectorScan<CDDetector>::writeBlock<float>(
+    const std::size_t, std::complex<float>*);
+template void DetectorScan<RK4Detector>::writeBlock<double>(
+    const std::size_t, std::complex<double>*);
+template void DetectorScan<RK4Detector>::writeBlock<float>(
+    const std::size_t, std::complex<float>*);
+template void DetectorScan<ExactDetector>::writeBlock<double>(
+    const std::size_t, std::complex<double>*);
+template void DetectorScan<ExactDetector>::writeBlock<float>(
+    const std::size_t, std::complex<float>*);
+template void DetectorScan<SemiImplicitDetector>::writeBlock<double>(
+    const std::size_t, std::complex<double>*);
+template void DetectorScan<SemiImplicitDetector>::writeBlock<float>(
+    const std::size_t, std::complex<float>*);
+template double DetectorScan<CDDetector>::writeAbsBlock<double>(
+    const std::size_t, double*, const DetectorBank::Pooling);
+template float DetectorScan<CDDetector>::writeAbsBlock<float>(
+    const std::size_t, float*, const DetectorBank::Pooling);
+template double DetectorScan<RK4Detector>::writeAbsBlock<double>(
+    const std::size_t, double*, const DetectorBank::Pooling);
+template float DetectorScan<RK4Detector>::writeAbsBlock<float>(
+    const std::size_t, float*, const DetectorBank::Pooling);
+template double DetectorScan<ExactDetector>::writeAbsBlock<double>(
+    const std::size_t, double*, const DetectorBank::Pooling);
+template float DetectorScan<ExactDetector>::writeAbsBlock<float>(
+    const std::size_t, float*, const DetectorBank::Pooling);
+template double DetectorScan<SemiImplicitDetector>::writeAbsBlock<double>(
+    const std::size_t, double*, const DetectorBank::Pooling);
+template float DetectorScan<SemiImplicitDetector>::writeAbsBlock<float>(
+    const std::size_t, float*, const DetectorBank::Pooling);
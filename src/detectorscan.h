@@ -0,0 +1,162 @@
+#ifndef _DETECTORSCAN_H_
+#define _DETECTORSCAN_H_
+
+#include <cstddef>
+#include <complex>
+
+#include "detectorbank.h"
+#include "detectortypes.h"
+
+class AbstractDetector;
+
+/*!
+ * Divide the time range of a single linear detector between threads.
+ *
+ * When \f$b = 0\f$ each of the numerical methods reduces to a second
+ * order linear recurrence
+ * \f[
+ * z[n] = a_1z[n-1] + a_2z[n-2] + \beta_0x[n] + \beta_1x[n-1] + \beta_2x[n-2]
+ * \f]
+ * whose state \f$s[n] = (z[n], z[n-1])\f$ evolves as
+ * \f$s[n] = Ms[n-1] + u[n]\f$ with the companion matrix \f$M\f$. The
+ * composition of these affine maps is associative, so the output may
+ * be found by a blocked scan:
+ *
+ * -# each block other than the last is run from a zero state to find
+ *    the contribution of its own input to the state at its end
+ *    (runBlock(), concurrently);
+ * -# the true state at the start of each block is found in sequence
+ *    from that of the previous block, using \f$M^L\f$ for a block of
+ *    length \f$L\f$ found by repeated squaring (propagate());
+ * -# each block is run again from its true starting state, writing
+ *    the normalised output (writeBlock(), concurrently).
+ *
+ * Roughly twice as much arithmetic is performed as by the serial
+ * methods, so this is worthwhile only when there are at least twice as
+ * many threads as channels. The recurrence is evaluated in a different
+ * order from the detector's own process() method, so results agree with
+ * it to within rounding error (about \f$10^{-12}\f$ relative to the peak
+ * output over a one second tone) rather than exactly. On completion
+ * the detector's state is as if it had processed the whole range itself.
+ *
+ * \tparam Solver The detector class (CDDetector, RK4Detector,
+ *                ExactDetector or SemiImplicitDetector) whose numerical
+ *                method is scanned.
+ */
+template <class Solver>
+class DetectorScan {
+public:
+    /*! Smallest number of samples worth giving a block of its own */
+    static constexpr std::size_t minBlock { 16384 };
+
+    /*!
+     * Whether a detector is linear and therefore able to be scanned.
+     * \param detector A detector of type Solver
+     * \return true if the detector's first Lyapunov coefficient is zero
+     */
+    static bool linear(const AbstractDetector* detector);
+
+    /*!
+     * Prepare to scan a detector over a range of input.
+     * \param detector The detector, which must be linear
+     * \param source Input samples for the detector
+     * \param count Number of samples to process
+     * \param blocks Number of blocks into which to divide the samples
+     * \param states Storage for the state of each of the blocks, which
+     *               the caller keeps for the life of the scan
+     * \param hop Number of samples per output frame. Each block other
+     *            than the last is a whole number of hops long, so hop
+     *            should not exceed count/blocks.
+     * \param gain Gain applied to the input samples as they are read
+     */
+    DetectorScan(AbstractDetector* detector,
+                 const inputSample_t* source,
+                 const std::size_t count,
+                 const std::size_t blocks,
+                 std::complex<parameter_t> (*states)[2],
+                 const std::size_t hop = 1,
+                 const parameter_t gain = 1);
+
+    /*!
+     * Find the state at the end of a block due to its input alone.
+     * This is required for every block except the last, and the
+     * blocks may be run concurrently.
+     * \param k Block number
+     */
+    void runBlock(const std::size_t k);
+
+    /*! Find the state at the start of every block. Called once all
+     *  runBlock() calls have completed. */
+    void propagate();
+
+    /*!
+     * Write the normalised output for a block, or the first output of
+     * each hop. The blocks may be run concurrently once propagate() has
+     * been called. When the final block is written, the detector's state
+     * is updated.
+     * \tparam T Precision of the output (float or double)
+     * \param k Block number
+     * \param target Output array for the whole range of the scan
+     */
+    template <typename T>
+    void writeBlock(const std::size_t k, std::complex<T>* target);
+
+    /*!
+     * Write the magnitudes of the normalised output for a block pooled
+     * over each hop, as writeBlock() does for the complex output.
+     * \tparam T Precision of the output (float or double)
+     * \param k Block number
+     * \param target Output array for the whole range of the scan
+     * \param pooling How each hop is pooled
+     * \return The largest value written
+     */
+    template <typename T>
+    T writeAbsBlock(const std::size_t k, T* target,
+                    const DetectorBank::Pooling pooling = DetectorBank::max_abs);
+
+private:
+    typedef std::complex<parameter_t> complex_t;
+
+    /*! Read the coefficients of the recurrence and the initial state
+     *  from the detector */
+    void load();
+    /*! Write the state at the end of the scan back to the detector
+     * \param zn1 Last output, z[count-1]
+     * \param zn2 Penultimate output, z[count-2] */
+    void store(const complex_t& zn1, const complex_t& zn2);
+    /*! Run block k from its true starting state, passing each
+     *  normalised output to write(n, z) */
+    template <class Write>
+    void finishBlock(const std::size_t k, Write write);
+
+    /*! Amplified input sample n of the range, or one from the detector's history
+     *  if n is negative (n >= -2) */
+    parameter_t x(const std::ptrdiff_t n) const
+    {
+        return n >= 0 ? inputSample_t(gain * source[n]) : n == -1 ? x1 : x2;
+    }
+
+    /*! First sample of block k, which is on a whole hop */
+    std::size_t blockStart(const std::size_t k) const
+    {
+        return k == blocks ? count : k * count / blocks / hop * hop;
+    }
+
+    Solver* const detector;           //!< Detector being scanned
+    const inputSample_t* const source;//!< Input samples
+    const std::size_t count;          //!< Number of samples
+    const std::size_t blocks;         //!< Number of blocks
+    const std::size_t hop;            //!< Samples per output frame
+    const parameter_t gain;           //!< Gain applied to the input
+
+    complex_t a1, a2;                 //!< Coefficients of z[n-1], z[n-2]
+    complex_t b0, b1, b2;             //!< Coefficients of x[n], x[n-1], x[n-2]
+    complex_t z1, z2;                 //!< Initial z[-1], z[-2]
+    parameter_t x1, x2;               //!< Initial x[-1], x[-2]
+
+    /*! State at the end of each block from its input alone (runBlock),
+     *  then the true state at the start of each block (propagate) */
+    complex_t (* const states)[2];
+};
+
+#endif
@@ -9,6 +9,8 @@ typedef double parameter_t;
 typedef double result_t;
 typedef float inputSample_t;
 typedef std::complex<result_t> discriminator_t;
+typedef float resultf_t;
+typedef std::complex<resultf_t> discriminatorf_t;
 typedef std::map<std::size_t, std::vector<std::size_t>> Onsets_t;
 
 #endif
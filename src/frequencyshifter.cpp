@@ -44,16 +44,83 @@ void FrequencyShifter::shift(const parameter_t fShift,
                              inputSample_t* shiftedSignal,
                              const std::size_t shiftedSignalSize)
 {
-    std::complex<parameter_t> c(1.0);
-    const std::complex<parameter_t> phase_inc {
-        std::exp(std::complex<parameter_t>(0., fShift*2.0*M_PI / sr))
-    };
+    FrequencyShift c(fShift, sr);
     
-    for (std::size_t i {0}; i < shiftedSignalSize; i++) {
-        
-        shiftedSignal[i] =
-            real(analyticSignal[i])*real(c) - imag(analyticSignal[i])*imag(c);
+    for (std::size_t i {0}; i < shiftedSignalSize; i++)
+        shiftedSignal[i] = c.next(real(analyticSignal[i]), imag(analyticSignal[i]));
+}
+
+FrequencyShifterStream::FrequencyShifterStream(const parameter_t sr,
+                                               const std::vector<parameter_t>& shifts)
+    : transformer(new HilbertFIR())
+{
+    for (const parameter_t fShift : shifts)
+        this->shifts.push_back(FrequencyShift(fShift, sr));
+    reset();
+}
+
+FrequencyShifterStream::~FrequencyShifterStream()
+{
+}
+
+std::size_t FrequencyShifterStream::latency() const
+{
+    return transformer->lookahead();
+}
+
+void FrequencyShifterStream::reserve(const std::size_t blockSize)
+{
+    samples.reserve(transformer->history() + transformer->lookahead() +
+                    std::max(blockSize, transformer->lookahead()));
+}
 
-        c *= phase_inc;
+void FrequencyShifterStream::reset()
+{
+    // Before the signal starts its samples are zero, as they are for
+    // the Hilbert transform of the whole signal
+    samples.assign(transformer->history(), 0);
+    for (FrequencyShift& shift : shifts)
+        shift.seek(0);
+}
+
+std::size_t FrequencyShifterStream::push(const inputSample_t* input,
+                                         const std::size_t blockSize,
+                                         inputSample_t* delayed,
+                                         inputSample_t* const* shifted)
+{
+    samples.insert(samples.end(), input, input + blockSize);
+
+    const std::size_t waiting { samples.size() - transformer->history() };
+    const std::size_t count {
+        waiting > transformer->lookahead() ? waiting - transformer->lookahead() : 0
+    };
+    shift(count, delayed, shifted);
+    return count;
+}
+
+std::size_t FrequencyShifterStream::flush(inputSample_t* delayed,
+                                          inputSample_t* const* shifted)
+{
+    const std::size_t count { samples.size() - transformer->history() };
+    samples.insert(samples.end(), transformer->lookahead(), 0);
+    shift(count, delayed, shifted);
+    reset();
+    return count;
+}
+
+void FrequencyShifterStream::shift(const std::size_t count,
+                                   inputSample_t* delayed,
+                                   inputSample_t* const* shifted)
+{
+    const inputSample_t* x { samples.data() + transformer->history() };
+
+    for (std::size_t i {0}; i < count; i++) {
+        const inputSample_t h { transformer->transform(x + i) };
+        delayed[i] = x[i];
+        for (std::size_t s {0}; s < shifts.size(); s++)
+            shifted[s][i] = shifts[s].next(x[i], h);
     }
+
+    // Keep the history of the next sample to be transformed
+    samples.erase(samples.begin(), samples.begin() + count);
 }
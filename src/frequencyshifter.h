@@ -1,10 +1,58 @@
 #ifndef _FREQUENCYSHIFTER_H_
 #define _FREQUENCYSHIFTER_H_
 
+#include <cmath>
 #include <complex>
+#include <memory>
+#include <vector>
 
 #include "detectortypes.h"
 
+class HilbertFIR;
+
+/*! A frequency shift applied to a signal a sample at a time, given the
+ *  signal and its Hilbert transform. FrequencyShifter and
+ *  FrequencyShifterStream shift their signals by this means, as do
+ *  detectors which shift their own input as they read it.
+ */
+struct FrequencyShift {
+    /*! Construct a FrequencyShift
+     *  \param fShift Frequency by which to shift the signal (Hz)
+     *  \param sr Sample rate of the signal
+     */
+    FrequencyShift(const parameter_t fShift = 0., const parameter_t sr = 1.)
+        : increment(std::exp(std::complex<parameter_t>(0., fShift*2.0*M_PI / sr)))
+        , phase(1.0)
+    { }
+
+    /*! Shift the next sample of the signal
+     *  \param x Sample of the signal
+     *  \param h Hilbert transform of the sample
+     *  \return The shifted sample
+     */
+    inputSample_t next(const inputSample_t x, const inputSample_t h)
+    {
+        const inputSample_t shifted = x*real(phase) - h*imag(phase);
+        phase *= increment;
+        return shifted;
+    }
+
+    /*! Set the phase to that of a given sample of the signal. The phase
+     *  is advanced from the start a sample at a time, so it is exactly
+     *  that reached by next().
+     *  \param n Sample number
+     */
+    void seek(const std::size_t n)
+    {
+        phase = 1.0;
+        for (std::size_t i {0}; i < n; i++)
+            phase *= increment;
+    }
+
+    std::complex<parameter_t> increment; /*!< Change of phase per sample */
+    std::complex<parameter_t> phase;     /*!< Phase at the next sample */
+};
+
 /*! Shift a signal by a given frequency. Use SSB modulation,
  *  implemented via the Hilbert transform (which is itself
  *  implemented with FFTs from the FFTW library).
@@ -60,4 +108,78 @@ protected:
     
 };
 
+/*! Shift a signal which arrives in blocks by several frequencies at once.
+ *
+ *  The Hilbert transform's most recent input and the phase of the
+ *  oscillator for each shift are kept from one block to the next, so the
+ *  output is exactly that of a FrequencyShifter, in FIR mode, given the
+ *  whole signal. The transform of each sample depends on latency()
+ *  later samples, so the output lags the input by that many samples
+ *  until flush() is called at the end of the signal.
+ */
+class FrequencyShifterStream {
+
+public:
+    /*! Construct a FrequencyShifterStream
+     *  \param sr Sample rate of the audio
+     *  \param shifts Frequencies by which to shift the signal (Hz)
+     */
+    FrequencyShifterStream(const parameter_t sr,
+                           const std::vector<parameter_t>& shifts);
+
+    ~FrequencyShifterStream();
+
+    /*! Number of samples by which the output lags the input */
+    std::size_t latency() const;
+
+    /*! Make room for blocks of up to blockSize samples, so that no
+     *  memory is allocated by push() or flush()
+     *  \param blockSize Largest block to be pushed
+     */
+    void reserve(const std::size_t blockSize);
+
+    /*! Add a block of the signal, and write the output which can now
+     *  be found. This is at most blockSize samples.
+     *  \param input Block of the signal
+     *  \param blockSize Length of the block
+     *  \param delayed Output buffer for the signal, delayed to match
+     *         the shifted signals
+     *  \param shifted Output buffer for each shift
+     *  \return Number of samples written to each output buffer
+     */
+    std::size_t push(const inputSample_t* input,
+                     const std::size_t blockSize,
+                     inputSample_t* delayed,
+                     inputSample_t* const* shifted);
+
+    /*! End the signal, writing the output of its last samples, which
+     *  is at most latency() samples, and start again.
+     *  \param delayed Output buffer for the delayed signal
+     *  \param shifted Output buffer for each shift
+     *  \return Number of samples written to each output buffer
+     */
+    std::size_t flush(inputSample_t* delayed,
+                      inputSample_t* const* shifted);
+
+    /*! Discard the signal so far and start again */
+    void reset();
+
+protected:
+    /*! Shift the samples whose transforms can be found
+     *  \param count Number of samples to shift
+     *  \param delayed Output buffer for the delayed signal
+     *  \param shifted Output buffer for each shift */
+    void shift(const std::size_t count,
+               inputSample_t* delayed,
+               inputSample_t* const* shifted);
+
+    /*! Hilbert transformer */
+    std::unique_ptr<HilbertFIR> transformer;
+    /*! The transformer's history, followed by the samples whose
+     *  transforms can't yet be found */
+    std::vector<inputSample_t> samples;
+    /*! Oscillator for each shift */
+    std::vector<FrequencyShift> shifts;
+};
+
 #endif
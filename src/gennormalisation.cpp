@@ -0,0 +1,131 @@
+/*
+ * Generate the normalisation tables in normalisation_values.inc
+ * (see NormalisationTable).
+ *
+ * For every table, bandwidth and frequency, a detector is search
+ * normalised (if the table requires it) and then amplitude normalised
+ * by AbstractDetector::searchNormalize() and
+ * AbstractDetector::amplitudeNormalize(), as DetectorBank would do
+ * without the tables, and its amplitude scale factor converted to that
+ * for unit gain.
+ *
+ * The sign of each amplitude scale factor, which is arbitrary, is chosen
+ * to give a positive real part, and that of the eccentricity correction
+ * to be positive, so that neighbouring entries may be interpolated.
+ *
+ * Built and run by
+ *   make normalisation-tables
+ * which takes some minutes.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "detectors.h"
+#include "normalisationtable.h"
+
+namespace {
+    // Search bounds and tone length, as used by DetectorBank
+    constexpr parameter_t searchStart {0.92}, searchEnd {1.08};
+    constexpr parameter_t toneDuration {3.};
+
+    constexpr parameter_t mu {0.}, gain {25.};
+
+    template <class Detector>
+    NormalisationTable::Entry normalise(const parameter_t f, const parameter_t bw,
+                                        const parameter_t sr, const bool searched)
+    {
+        Detector det(f, mu, NormalisationTable::damping, sr, bw, gain);
+        if (searched && !det.searchNormalize(searchStart, searchEnd, toneDuration, gain))
+            return NormalisationTable::Entry {0, 1, 0, 1};
+        det.amplitudeNormalize(gain);
+        const NormalisationCache::Value value { det.getNormalisation() };
+
+        // For unit gain
+        discriminator_t aScale { value.aScale * gain };
+        if (aScale.real() < 0)
+            aScale = -aScale;
+        return NormalisationTable::Entry {
+            value.w / (2.0*M_PI*f), aScale.real(), aScale.imag(), std::abs(value.iScale)
+        };
+    }
+}
+
+int main()
+{
+    using Table = std::vector<NormalisationTable::Entry>;
+    std::vector<Table> tables(NormalisationTable::numTables,
+                              Table(NormalisationTable::numBandwidths *
+                                    NormalisationTable::numFrequencies));
+
+    // Every entry is independent, so they are shared among threads
+    const std::size_t perTable {
+        NormalisationTable::numBandwidths * NormalisationTable::numFrequencies
+    };
+    const std::size_t numEntries { NormalisationTable::numTables * perTable };
+    std::atomic<std::size_t> next {0};
+
+    auto work {
+        [&]() {
+            for (std::size_t e; (e = next++) < numEntries; ) {
+                const std::size_t t { e / perTable };
+                const std::size_t j { e % perTable / NormalisationTable::numFrequencies };
+                const std::size_t k { e % NormalisationTable::numFrequencies };
+
+                // Tables are ordered by method, frequency normalisation
+                // and sample rate
+                const int method { NormalisationTable::methods[t/4] };
+                const bool searched {
+                    NormalisationTable::freqNormalizations[t/2 % 2] ==
+                    DetectorBank::Features::search_normalized
+                };
+                const parameter_t sr { NormalisationTable::sampleRates[t % 2] };
+                const parameter_t f { NormalisationTable::frequency(k) };
+                const parameter_t bw { NormalisationTable::bandwidths[j] };
+
+                tables[t][e % perTable] =
+                    method == DetectorBank::Features::runge_kutta ?
+                        normalise<RK4Detector>(f, bw, sr, searched) :
+                        normalise<SemiImplicitDetector>(f, bw, sr, searched);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned n {0}; n < std::max(1u, std::thread::hardware_concurrency()); n++)
+        threads.emplace_back(work);
+    for (auto& thread : threads)
+        thread.join();
+
+    std::printf("// Normalisation tables for NormalisationTable, made by gennormalisation.cpp\n"
+                "// Entries are {ratio, aReal, aImag, iScale}; see NormalisationTable::Entry\n\n"
+                "const NormalisationTable::Entry NormalisationTable::entries"
+                "[numTables][numBandwidths][numFrequencies] = {\n");
+    for (std::size_t t {0}; t < NormalisationTable::numTables; t++) {
+        std::printf("  { // method %d, frequency normalisation %d, %gHz\n",
+                    NormalisationTable::methods[t/4],
+                    NormalisationTable::freqNormalizations[t/2 % 2],
+                    NormalisationTable::sampleRates[t % 2]);
+        for (std::size_t j {0}; j < NormalisationTable::numBandwidths; j++) {
+            std::printf("    { // %gHz bandwidth\n", NormalisationTable::bandwidths[j]);
+            for (std::size_t k {0}; k < NormalisationTable::numFrequencies; k++) {
+                const NormalisationTable::Entry& e {
+                    tables[t][j*NormalisationTable::numFrequencies + k]
+                };
+                std::printf("      {%.10g, %.10g, %.10g, %.10g}%s\n",
+                            e.ratio, e.aReal, e.aImag, e.iScale,
+                            k+1 < NormalisationTable::numFrequencies ? "," : "");
+            }
+            std::printf("    }%s\n", j+1 < NormalisationTable::numBandwidths ? "," : "");
+        }
+        std::printf("  }%s\n", t+1 < NormalisationTable::numTables ? "," : "");
+    }
+    std::printf("};\n");
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <complex>
 #include <cmath>
+#include <vector>
 #include <fftw3.h>
 
 #include "hilbert.h"
@@ -88,27 +89,39 @@ void HilbertFIR::hilbert(const inputSample_t* inputSignal,
                          std::complex<inputSample_t>* analyticSignal,
                          const std::size_t signalSize)
 {
-    std::size_t halfklen {FIRlength / 2};
-    std::size_t koffset {0};
-    std::size_t kmin, kmax;
-    inputSample_t h;
-    
-    if (halfklen == kernelSize) {
-        koffset = 1;
-    }
-    
-    for (std::size_t n {halfklen}; n < signalSize+halfklen-1; n++) {
-        kmin = std::max(static_cast<int>(n-(FIRlength-1)), 0) + koffset;
-        kmax = std::min(n, signalSize-1) + koffset;
-        
-        h = 0.;
-        
-        for (std::size_t i {kmin}; i < kmax-1; i+=2) {
-            h += inputSignal[i] * kernel[(n-i)/2];
-        }
-        
-        analyticSignal[n-halfklen] = std::complex<inputSample_t>(inputSignal[n-halfklen], h);
+    std::vector<inputSample_t> window(history() + lookahead() + 1);
+
+    for (std::size_t n {0}; n < signalSize; n++)
+        analyticSignal[n] = std::complex<inputSample_t>(
+            inputSignal[n], transform(inputSignal, n, signalSize, window));
+}
+
+void HilbertFIR::transform(const inputSample_t* inputSignal,
+                           inputSample_t* hilbertSignal,
+                           const std::size_t signalSize)
+{
+    std::vector<inputSample_t> window(history() + lookahead() + 1);
+
+    for (std::size_t n {0}; n < signalSize; n++)
+        hilbertSignal[n] = transform(inputSignal, n, signalSize, window);
+}
+
+inputSample_t HilbertFIR::transform(const inputSample_t* inputSignal,
+                                    const std::size_t n,
+                                    const std::size_t signalSize,
+                                    std::vector<inputSample_t>& window) const
+{
+    if (n >= history() && n + lookahead() < signalSize)
+        return transform(inputSignal + n);
+
+    // Samples beyond the ends of the signal are taken to be zero, so
+    // the transforms of the first and last few samples are found from
+    // a copy of their neighbourhood
+    for (std::size_t i {0}; i < window.size(); i++) {
+        const std::size_t k {n + i - history()};
+        window[i] = (n + i >= history() && k < signalSize) ? inputSignal[k] : 0;
     }
+    return transform(window.data() + history());
 }
 
 void HilbertFIR::make_kernel(inputSample_t* array, std::size_t N)
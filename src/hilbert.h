@@ -2,6 +2,7 @@
 #define _HILBERT_H_
 
 #include <complex>
+#include <vector>
 
 #include "detectortypes.h"
 
@@ -49,12 +50,42 @@ public:
     virtual void hilbert(const inputSample_t* inputSignal,
                          std::complex<inputSample_t>* analyticSignal,
                          const std::size_t signalSize);
+    /*! Get the Hilbert transform alone, as the imaginary part of the
+     *  analytic signal found by hilbert()
+     * \param inputSignal Signal to be transformed
+     * \param hilbertSignal Output array to be filled
+     * \param signalSize Size of both signals
+     */
+    void transform(const inputSample_t* inputSignal,
+                   inputSample_t* hilbertSignal,
+                   const std::size_t signalSize);
     /*! Default FIR length is 19, but can be changed.
      *  \param length New FIRlength
      */
     void setFIRlength(std::size_t length);
+    /*! Number of samples before each sample on which its transform depends */
+    std::size_t history() const { return FIRlength/2 - offset(); }
+    /*! Number of samples after each sample on which its transform depends */
+    std::size_t lookahead() const { return FIRlength/2 + offset() - 2; }
+    /*! Hilbert transform of one sample of a signal, as found by hilbert()
+     *  \param x Pointer to the sample. The history() samples before it
+     *         and the lookahead() samples after it must be readable, and
+     *         zero where they lie beyond the ends of the signal.
+     *  \return Imaginary part of the analytic signal at the sample
+     */
+    inputSample_t transform(const inputSample_t* x) const
+    {
+        const inputSample_t* first {x - history()};
+        inputSample_t h {0.};
+        for (std::size_t i {0}; i <= history() + lookahead(); i += 2)
+            h += first[i] * kernel[(FIRlength/2 + history() - i)/2];
+        return h;
+    }
 
 protected:
+    /*! 1 if, for this FIR length, the kernel's taps are shifted one
+     *  sample later, otherwise 0 */
+    std::size_t offset() const { return FIRlength/2 == kernelSize ? 1 : 0; }
     /*! length of FIR filter (must be odd) */
     std::size_t FIRlength;
     /*! kernel size */
@@ -66,6 +97,17 @@ protected:
      *  \param N size of kernel
      */
     void make_kernel(inputSample_t* array, std::size_t N);
+    /*! Hilbert transform of one sample of a finite signal, outside which
+     *  the signal is taken to be zero
+     *  \param inputSignal Signal to be transformed
+     *  \param n Sample number
+     *  \param signalSize Size of the signal
+     *  \param window Scratch space of history() + lookahead() + 1 samples
+     */
+    inputSample_t transform(const inputSample_t* inputSignal,
+                            const std::size_t n,
+                            const std::size_t signalSize,
+                            std::vector<inputSample_t>& window) const;
     /*! Get value for blackman window
      *  \param n current sample 
      *  \param N window length
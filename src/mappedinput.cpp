@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedinput.h"
+#include "pcmconverter.h"
+
+namespace {
+    // WAV format tags
+    constexpr unsigned pcm {1};
+    constexpr unsigned ieeeFloat {3};
+    constexpr unsigned extensible {0xfffe};
+
+    // Little-endian fields of a WAV file
+    unsigned le16(const unsigned char* p)
+    {
+        return p[0] | p[1] << 8;
+    }
+
+    std::uint32_t le32(const unsigned char* p)
+    {
+        return std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 |
+               std::uint32_t(p[2]) << 16 | std::uint32_t(p[3]) << 24;
+    }
+
+    bool littleEndian()
+    {
+        const std::uint32_t one {1};
+        unsigned char first;
+        std::memcpy(&first, &one, 1);
+        return first == 1;
+    }
+
+    // One sample of a WAV file as a float in [-1, 1)
+    inputSample_t sample(const unsigned char* p, const unsigned format,
+                         const unsigned bits)
+    {
+        if (format == ieeeFloat) {
+            const std::uint32_t u {le32(p)};
+            float f;
+            std::memcpy(&f, &u, sizeof(f));
+            return f;
+        }
+        switch (bits) {
+            case 16:
+                return std::int16_t(le16(p)) / 32768.f;
+            case 24:
+                // Sign extended from the top of a 32-bit word
+                return std::int32_t(std::uint32_t(p[0]) << 8 |
+                                    std::uint32_t(p[1]) << 16 |
+                                    std::uint32_t(p[2]) << 24) / 2147483648.f;
+            default:
+                return std::int32_t(le32(p)) / 2147483648.f;
+        }
+    }
+}
+
+MappedInput::MappedInput(const std::string& path, const parameter_t sr)
+    : mapping(nullptr)
+    , mappingSize(0)
+    , offset(0)
+    , samples(nullptr)
+    , numSamples(0)
+    , sr(sr)
+{
+    const int fd {open(path.c_str(), O_RDONLY)};
+    if (fd < 0)
+        throw std::runtime_error("Can't open " + path + ": " + std::strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const int error {errno};
+        close(fd);
+        throw std::runtime_error("Can't read " + path + ": " + std::strerror(error));
+    }
+    mappingSize = st.st_size;
+
+    if (mappingSize > 0) {
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const int error {errno};
+            mapping = nullptr;
+            close(fd);
+            throw std::runtime_error("Can't map " + path + ": " + std::strerror(error));
+        }
+    }
+    // The mapping holds its own reference to the file
+    close(fd);
+
+    const unsigned char* bytes {static_cast<const unsigned char*>(mapping)};
+    try {
+        if (mappingSize >= 12 && std::memcmp(bytes, "RIFF", 4) == 0 &&
+            std::memcmp(bytes + 8, "WAVE", 4) == 0)
+            readWAV(bytes, mappingSize);
+        else {
+            if (sr <= 0)
+                throw std::invalid_argument("The sample rate of a raw file should be given.");
+            samples = static_cast<const inputSample_t*>(mapping);
+            numSamples = mappingSize / sizeof(inputSample_t);
+        }
+    }
+    catch (...) {
+        if (mapping)
+            munmap(mapping, mappingSize);
+        throw;
+    }
+
+    // Samples which were converted are no longer read from the file
+    if (converted) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+    }
+    else if (mapping)
+        madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+}
+
+MappedInput::~MappedInput()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+}
+
+void MappedInput::readWAV(const unsigned char* bytes, const std::size_t fileSize)
+{
+    const unsigned char* fmt {nullptr};
+    std::size_t dataOffset {0}, dataSize {0};
+
+    // Chunks follow the RIFF header, each padded to an even length
+    for (std::size_t pos {12}; pos + 8 <= fileSize; ) {
+        const std::size_t chunkSize {le32(bytes + pos + 4)};
+        if (std::memcmp(bytes + pos, "fmt ", 4) == 0 && chunkSize >= 16 &&
+            pos + 8 + chunkSize <= fileSize)
+            fmt = bytes + pos + 8;
+        else if (std::memcmp(bytes + pos, "data", 4) == 0) {
+            dataOffset = pos + 8;
+            // The size of a stream that was never finished may be wrong
+            dataSize = std::min(chunkSize, fileSize - dataOffset);
+            break;
+        }
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+    if (!fmt || !dataOffset)
+        throw std::invalid_argument("WAV file has no format or no data.");
+
+    unsigned format {le16(fmt)};
+    const unsigned channels {le16(fmt + 2)};
+    const unsigned blockAlign {le16(fmt + 12)};
+    const unsigned bits {le16(fmt + 14)};
+    // The format of an extensible file is the first two bytes of its
+    // subformat GUID
+    if (format == extensible && le16(fmt + 16) >= 22)
+        format = le16(fmt + 24);
+    sr = le32(fmt + 4);
+
+    const bool supported {
+        (format == pcm && (bits == 16 || bits == 24 || bits == 32)) ||
+        (format == ieeeFloat && bits == 32)
+    };
+    if (!supported || channels == 0 || blockAlign != channels * (bits / 8) || sr <= 0)
+        throw std::invalid_argument("WAV files should hold 16, 24 or 32-bit "
+                                    "PCM or 32-bit floating point samples.");
+
+    numSamples = dataSize / blockAlign;
+    const unsigned char* data {bytes + dataOffset};
+
+    if (format == ieeeFloat && channels == 1 && littleEndian() &&
+        dataOffset % alignof(inputSample_t) == 0) {
+        offset = dataOffset;
+        samples = reinterpret_cast<const inputSample_t*>(data);
+        return;
+    }
+
+    converted.reset(new inputSample_t[numSamples]);
+    const unsigned width {bits / 8};
+
+    // Aligned samples in the byte order of the host are converted by
+    // PCMConverter, and others a byte at a time
+    if (littleEndian() && dataOffset % width == 0 && bits != 24) {
+        if (format == ieeeFloat)
+            PCMConverter::convert(reinterpret_cast<const inputSample_t*>(data),
+                                  numSamples, channels, converted.get());
+        else if (bits == 16)
+            PCMConverter::convert(reinterpret_cast<const std::int16_t*>(data),
+                                  numSamples, channels, converted.get());
+        else
+            PCMConverter::convert(reinterpret_cast<const std::int32_t*>(data),
+                                  numSamples, channels, converted.get());
+        samples = converted.get();
+        return;
+    }
+
+    for (std::size_t i {0}; i < numSamples; i++) {
+        const unsigned char* frame {data + i * blockAlign};
+        inputSample_t sum {0};
+        for (unsigned c {0}; c < channels; c++)
+            sum += sample(frame + c * width, format, bits);
+        converted[i] = sum / channels;
+    }
+    samples = converted.get();
+}
+
+void MappedInput::willNeed(const std::size_t first, const std::size_t count) const
+{
+    advise(first, count, true, MADV_WILLNEED);
+}
+
+void MappedInput::release(const std::size_t first, const std::size_t count) const
+{
+    advise(first, count, false, MADV_DONTNEED);
+}
+
+void MappedInput::advise(const std::size_t first, const std::size_t count,
+                         const bool outward, const int advice) const
+{
+    if (!mapping || first >= numSamples)
+        return;
+
+    const std::size_t page ( sysconf(_SC_PAGESIZE) );
+    const std::size_t last {std::min(first + count, numSamples)};
+    const std::size_t begin {(offset + first * sizeof(inputSample_t)) / page * page};
+    std::size_t end {offset + last * sizeof(inputSample_t)};
+    end = outward ? std::min((end + page - 1) / page * page, mappingSize)
+                  : end / page * page;
+
+    if (end > begin)
+        madvise(static_cast<char*>(mapping) + begin, end - begin, advice);
+}
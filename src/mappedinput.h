@@ -0,0 +1,105 @@
+#ifndef _MAPPEDINPUT_H_
+#define _MAPPEDINPUT_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "detectortypes.h"
+
+/*!
+ * Audio input read from a file mapped into memory, so that a long
+ * recording needn't be read into memory before a DetectorBank is made.
+ *
+ * The file may be a WAV file or a file of raw 32-bit floating point
+ * samples in the byte order of the host, such as is written by numpy's
+ * `tofile()`. Mono 32-bit floating point samples, whether raw or in a
+ * WAV file, are read from the mapping where they are, and pages of the
+ * file are only read as they are needed. Other WAV files (16, 24 or
+ * 32-bit integer PCM, or more than one channel) are converted to mono
+ * floating point as they are mapped, and the mapping is then dropped;
+ * integer samples are scaled to lie in [-1, 1) and the channels are
+ * averaged.
+ *
+ * A reader of the samples may advise which of them it will read next
+ * and which it has finished with (see willNeed() and release()), so
+ * that the file is read ahead of it and only the part of the file being
+ * read is resident.
+ */
+class MappedInput {
+public:
+    /*!
+     * Map a file of audio.
+     * \param path Path of a WAV file or of a file of raw float32 samples
+     * \param sr Sample rate of a raw file. The sample rate of a WAV file
+     * is read from the file, and sr is ignored.
+     * \throw std::runtime_error The file can't be opened or mapped.
+     * \throw std::invalid_argument The file's format isn't supported,
+     * or no sample rate is given for a raw file.
+     */
+    MappedInput(const std::string& path, const parameter_t sr = 0);
+    ~MappedInput();
+
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+
+    /*! The samples of the file
+     * \return Pointer to the first sample */
+    const inputSample_t* data() const { return samples; }
+    /*! The number of samples in the file
+     * \return Number of (mono) samples */
+    std::size_t size() const { return numSamples; }
+    /*! The sample rate of the audio
+     * \return Sample rate */
+    parameter_t getSR() const { return sr; }
+    /*! Whether the samples are read from the mapped file, rather than
+     *  from a converted copy of them
+     * \return true if the samples are mapped */
+    bool isMapped() const { return mapping != nullptr; }
+
+    /*!
+     * Advise that samples are to be read soon, so that the part of the
+     * file holding them may be read ahead. Does nothing unless the
+     * samples are mapped.
+     * \param first First sample to be read
+     * \param count Number of samples to be read
+     */
+    void willNeed(const std::size_t first, const std::size_t count) const;
+    /*!
+     * Advise that samples have been read, so that the pages holding them
+     * may be dropped from memory. They are read from the file again if
+     * they are needed later. The page holding the sample after the last
+     * of them is kept. Does nothing unless the samples are mapped.
+     * \param first First sample which has been read
+     * \param count Number of samples which have been read
+     */
+    void release(const std::size_t first, const std::size_t count) const;
+
+private:
+    /*! Find the format and the data of a WAV file, and set samples to
+     *  the data, or to a converted copy of it
+     * \param bytes Contents of the file
+     * \param fileSize Size of the file */
+    void readWAV(const unsigned char* bytes, const std::size_t fileSize);
+    /*! Apply madvise() to the pages holding a range of samples
+     * \param first First sample
+     * \param count Number of samples
+     * \param outward If true, partly covered pages at either end are
+     * included, otherwise only the pages before the one holding the
+     * sample after the range are
+     * \param advice Advice to be given */
+    void advise(const std::size_t first, const std::size_t count,
+                const bool outward, const int advice) const;
+
+    void* mapping;                    /*!< The mapped file, or null */
+    std::size_t mappingSize;          /*!< Size of the mapped file */
+    std::size_t offset;               /*!< Offset of the samples in the file */
+    const inputSample_t* samples;     /*!< The samples */
+    std::size_t numSamples;           /*!< Number of samples */
+    parameter_t sr;                   /*!< Sample rate */
+    /*! Samples converted from another format, if they couldn't be
+     *  read in place */
+    std::unique_ptr<inputSample_t[]> converted;
+};
+
+#endif
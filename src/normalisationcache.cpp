@@ -0,0 +1,199 @@
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "normalisationcache.h"
+
+#ifndef PACKAGE_VERSION
+#  define PACKAGE_VERSION "unknown"
+#endif
+
+const char NormalisationCache::format[] { "v5" };
+
+namespace {
+    // Eleven values per entry: the key, then the value
+    constexpr int fieldsPerEntry {11};
+
+    // Hexadecimal floating point, which reads back exactly
+    std::string hex(const double v)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%a", v);
+        return buf;
+    }
+}
+
+NormalisationCache& NormalisationCache::instance()
+{
+    static NormalisationCache cache;
+    return cache;
+}
+
+NormalisationCache::NormalisationCache()
+    : loaded(false)
+{
+    const char* env { std::getenv("DETECTORBANK_CACHE") };
+    const char* xdg { std::getenv("XDG_CACHE_HOME") };
+    const char* home { std::getenv("HOME") };
+
+    // A relative XDG_CACHE_HOME is invalid, so is ignored
+    std::string dir;
+    if (xdg && xdg[0] == '/')
+        dir = xdg;
+    else if (home)
+        dir = std::string(home) + "/.cache";
+
+    if (env)
+        path = env;
+    else if (!dir.empty()) {
+        // The file is kept even if its directory can't be made
+        mkdir(dir.c_str(), 0700);
+        path = dir + "/detectorbank-normalisation";
+    }
+}
+
+NormalisationCache::~NormalisationCache()
+{
+    write();
+}
+
+std::string NormalisationCache::header()
+{
+    return std::string("detectorbank ") + PACKAGE_VERSION +
+           " normalisation " + format;
+}
+
+bool NormalisationCache::find(const Key& key, Value& value)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!loaded)
+        load();
+
+    const auto it { entries.find(key) };
+    if (it == entries.end())
+        return false;
+    value = it->second;
+    return true;
+}
+
+void NormalisationCache::insert(const Key& key, const Value& value)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!loaded)
+        load();
+
+    entries[key] = value;
+    if (!path.empty())
+        pending.emplace_back(key, value);
+}
+
+void NormalisationCache::flush()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    write();
+}
+
+void NormalisationCache::setPath(const std::string& newPath)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    write();
+    path = newPath;
+    entries.clear();
+    loaded = false;
+}
+
+void NormalisationCache::write()
+{
+    if (pending.empty())
+        return;
+
+    std::ostringstream batch;
+    for (const auto& entry : pending) {
+        const Key& key { entry.first };
+        const Value& value { entry.second };
+        batch << key.features << ' ' << hex(key.sr) << ' ' << hex(key.f) << ' '
+              << hex(key.bandwidth) << ' ' << hex(key.mu) << ' ' << hex(key.d) << ' '
+              << hex(key.gain) << ' ' << hex(value.w) << ' '
+              << hex(value.aScale.real()) << ' ' << hex(value.aScale.imag()) << ' '
+              << hex(value.iScale) << '\n';
+    }
+    pending.clear();
+
+    const int fd { open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644) };
+    if (fd < 0)
+        return;
+
+    // Other processes may be writing the file too, so it's checked and
+    // appended to under an exclusive lock. A missing or out of date file
+    // is replaced
+    flock(fd, LOCK_EX);
+    const std::string first { header() + '\n' };
+    std::string found(first.size(), '\0');
+    std::string text { batch.str() };
+    if (pread(fd, &found[0], found.size(), 0) != ssize_t(found.size()) || found != first) {
+        if (ftruncate(fd, 0) == 0)
+            text.insert(0, first);
+        else
+            text.clear();
+    }
+    for (std::size_t done {0}; done < text.size(); ) {
+        const ssize_t n { ::write(fd, text.data() + done, text.size() - done) };
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+void NormalisationCache::load()
+{
+    loaded = true;
+    if (path.empty())
+        return;
+
+    // Another process's entries are read only once they're complete
+    const int fd { open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+    if (fd < 0)
+        return;
+    flock(fd, LOCK_SH);
+
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line) || line != header()) {
+        close(fd);
+        return;
+    }
+
+    // Later entries replace earlier ones with the same key, and a
+    // truncated final line is skipped.
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string field[fieldsPerEntry];
+        double v[fieldsPerEntry];
+        int n {0};
+        while (n < fieldsPerEntry && fields >> field[n]) {
+            char* end;
+            v[n] = std::strtod(field[n].c_str(), &end);
+            if (*end)
+                break;
+            n++;
+        }
+        if (n < fieldsPerEntry)
+            continue;
+
+        const Key key { static_cast<int>(v[0]), v[1], v[2], v[3], v[4], v[5], v[6] };
+        entries[key] = Value { v[7], discriminator_t(v[8], v[9]), v[10] };
+    }
+    close(fd);
+}
@@ -0,0 +1,124 @@
+#ifndef _NORMALISATIONCACHE_H_
+#define _NORMALISATIONCACHE_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "detectortypes.h"
+
+/*!
+ * Results of frequency and amplitude normalisation, kept so that
+ * detectors with the same parameters needn't be normalised again.
+ *
+ * Normalising a detector requires several seconds of audio to be run
+ * through test detectors (see AbstractDetector::searchNormalize() and
+ * AbstractDetector::amplitudeNormalize()), so constructing a normalised
+ * bank of many detectors is slow. The adjusted frequency and amplitude
+ * scale factors found for each detector are therefore kept in memory
+ * for the life of the process and appended to a file, from which they
+ * are read by later processes. The results found while making a bank
+ * are appended together by flush().
+ *
+ * The file is `detectorbank-normalisation` in `$XDG_CACHE_HOME`, or in
+ * `~/.cache` if that isn't set, unless the environment variable
+ * `DETECTORBANK_CACHE` gives another path; if that variable is set but
+ * empty, results are kept in memory only. The file begins with the
+ * library version and the cache format, and is ignored (and later
+ * replaced) if either differs from those of the running library. Values
+ * are written in hexadecimal floating point so they read back exactly.
+ *
+ * The cache is shared by every DetectorBank in the process and may be
+ * used from several threads at once. The file may be shared by several
+ * processes at once: it's read under a shared `flock()` and written
+ * under an exclusive one.
+ */
+class NormalisationCache {
+public:
+    /*! The parameters which determine the result of normalising a detector */
+    struct Key {
+        int features;          /*!< Numerical method and normalisations */
+        parameter_t sr;        /*!< Sample rate */
+        parameter_t f;         /*!< Frequency after any frequency shift */
+        parameter_t bandwidth; /*!< Detector bandwidth */
+        parameter_t mu;        /*!< Distance from the bifurcation point */
+        parameter_t d;         /*!< Damping */
+        parameter_t gain;      /*!< Gain */
+
+        /*! Order keys for std::map */
+        bool operator<(const Key& other) const
+        {
+            return std::tie(features, sr, f, bandwidth, mu, d, gain) <
+                   std::tie(other.features, other.sr, other.f, other.bandwidth,
+                            other.mu, other.d, other.gain);
+        }
+    };
+
+    /*! The result of normalising a detector */
+    struct Value {
+        parameter_t w;          /*!< Adjusted characteristic frequency (rad/s) */
+        discriminator_t aScale; /*!< Amplitude scaling factor */
+        parameter_t iScale;     /*!< Scaling factor for imaginary part */
+    };
+
+    /*! Format of the cache file, to be changed whenever the results of
+     *  normalisation would change within a release */
+    static const char format[];
+
+    /*! The cache used by all DetectorBanks
+     * \return The cache */
+    static NormalisationCache& instance();
+
+    /*!
+     * Look for the result of normalising a detector.
+     * \param key Parameters of the detector
+     * \param value Set to the result if it is found
+     * \return true if the result was found
+     */
+    bool find(const Key& key, Value& value);
+
+    /*!
+     * Record the result of normalising a detector in memory. It's
+     * written to the file by the next call to flush().
+     * \param key Parameters of the detector
+     * \param value Result of normalisation
+     */
+    void insert(const Key& key, const Value& value);
+
+    /*! Append the results recorded since the last call to the file */
+    void flush();
+
+    /*!
+     * Use a different file. Results not yet written are written to the
+     * old file, those held in memory are discarded, and those in the new
+     * file are read when next needed.
+     * \param path Path of the cache file, or an empty string to keep
+     *             results in memory only
+     */
+    void setPath(const std::string& path);
+
+private:
+    NormalisationCache();
+    ~NormalisationCache();
+
+    /*! Write the results not yet written. Called with lock held. */
+    void write();
+
+    /*! Read the cache file, if it's valid. Called with lock held. */
+    void load();
+
+    /*! First line of a valid cache file */
+    static std::string header();
+
+    std::mutex lock;                  /*!< Guards the members below */
+    std::string path;                 /*!< Cache file, or empty */
+    bool loaded;                      /*!< The file has been read */
+    std::map<Key, Value> entries;     /*!< Known results */
+    /*! Results not yet written to the file */
+    std::vector<std::pair<Key, Value>> pending;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+#include "detectorbank.h"
+#include "normalisationtable.h"
+
+const int NormalisationTable::methods[] {
+    DetectorBank::Features::runge_kutta,
+    DetectorBank::Features::semi_implicit
+};
+
+const int NormalisationTable::freqNormalizations[] {
+    DetectorBank::Features::freq_unnormalized,
+    DetectorBank::Features::search_normalized
+};
+
+const parameter_t NormalisationTable::sampleRates[] { 44100., 48000. };
+
+const parameter_t NormalisationTable::bandwidths[numBandwidths] {
+    1., 1.5, 2., 3., 5., 7., 10., 15., 20., 30.
+};
+
+int NormalisationTable::table(const int features, const parameter_t sr)
+{
+    const int solver { features & DetectorBank::solverMask };
+    const int freqNormalization { features & DetectorBank::freqNormalizationMask };
+
+    for (int m {0}; m < 2; m++)
+        for (int n {0}; n < 2; n++)
+            for (int r {0}; r < 2; r++)
+                if (methods[m] == solver &&
+                    freqNormalizations[n] == freqNormalization &&
+                    sampleRates[r] == sr)
+                    return (m*2 + n)*2 + r;
+    return -1;
+}
+
+bool NormalisationTable::find(const NormalisationCache::Key& key,
+                              NormalisationCache::Value& value)
+{
+    const int t { table(key.features, key.sr) };
+    if (t < 0 || key.mu != 0 || key.d != damping)
+        return false;
+
+    // Position between columns
+    const parameter_t x { std::log2(key.f / lowestFrequency) * perOctave };
+    if (!(x >= 0 && x <= numFrequencies - 1))
+        return false;
+    const std::size_t i { std::min(static_cast<std::size_t>(x), numFrequencies - 2) };
+    const parameter_t fx { x - i };
+
+    // Position between rows. The results change less evenly with
+    // bandwidth, so the four nearest rows are used.
+    if (!(key.bandwidth >= bandwidths[0] &&
+          key.bandwidth <= bandwidths[numBandwidths - 1]))
+        return false;
+    const std::size_t j {
+        static_cast<std::size_t>(
+            std::upper_bound(bandwidths, bandwidths + numBandwidths, key.bandwidth) -
+            bandwidths - 1)
+    };
+    const std::size_t firstRow { std::min(j > 0 ? j - 1 : 0, numBandwidths - 4) };
+
+    // Lagrange interpolation between the rows and linear interpolation
+    // between the columns, in the logarithms of bandwidth and frequency
+    const parameter_t y { std::log(key.bandwidth) };
+    parameter_t rowWeight[4];
+    for (std::size_t r {0}; r < 4; r++) {
+        rowWeight[r] = 1;
+        for (std::size_t q {0}; q < 4; q++)
+            if (q != r)
+                rowWeight[r] *= (y - std::log(bandwidths[firstRow + q])) /
+                                (std::log(bandwidths[firstRow + r]) -
+                                 std::log(bandwidths[firstRow + q]));
+    }
+
+    // The magnitudes of the amplitude scale factors are interpolated
+    // logarithmically and their phases as unit vectors
+    parameter_t ratio {0}, logMagnitude {0}, iScale {0};
+    discriminator_t phase {0};
+    for (std::size_t r {0}; r < 4; r++)
+        for (std::size_t c {0}; c < 2; c++) {
+            const Entry& e { entries[t][firstRow + r][i + c] };
+            if (e.ratio == 0)
+                return false;
+            const parameter_t weight { rowWeight[r] * (c ? fx : 1 - fx) };
+            const discriminator_t a { e.aReal, e.aImag };
+            ratio += weight * e.ratio;
+            logMagnitude += weight * std::log(std::abs(a));
+            phase += weight * a / std::abs(a);
+            iScale += weight * e.iScale;
+        }
+
+    if ((key.features & DetectorBank::freqNormalizationMask) ==
+        DetectorBank::Features::search_normalized)
+        value.w = 2.*M_PI * key.f * ratio;
+    else
+        value.w = key.f*2.0*M_PI;
+    if ((key.features & DetectorBank::ampNormalizationMask) ==
+        DetectorBank::Features::amp_normalized) {
+        value.aScale = std::polar(std::exp(logMagnitude) / key.gain, std::arg(phase));
+        value.iScale = iScale;
+    } else {
+        value.aScale = 1;
+        value.iScale = 1;
+    }
+    return true;
+}
+
+#include "normalisation_values.inc"
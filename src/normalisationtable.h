@@ -0,0 +1,94 @@
+#ifndef _NORMALISATIONTABLE_H_
+#define _NORMALISATIONTABLE_H_
+
+#include <cmath>
+#include <cstddef>
+
+#include "detectortypes.h"
+#include "normalisationcache.h"
+
+/*!
+ * Precomputed results of normalising nonlinear detectors.
+ *
+ * Detectors whose bandwidth is greater than the minimum are nonlinear,
+ * so their normalisation can't be calculated directly (see
+ * AbstractDetector::isLinear()) and would otherwise require test tones to
+ * be run through each one. The results are instead tabulated, for the
+ * Runge-Kutta and semi-implicit methods, with and without search
+ * normalisation, at 44.1kHz and 48kHz, over a grid of frequencies spaced
+ * evenly in pitch and of bandwidths. The tables apply to detectors with
+ * the default damping and \f$\mu = 0\f$. Any gain may be used: scaling
+ * the input scales \f$z\f$ by the same factor, because the first Lyapunov
+ * coefficient is inversely proportional to the square of the gain, so
+ * the amplitude scale factors are tabulated for unit gain.
+ *
+ * The tables are in normalisation_values.inc, which is made by
+ * gennormalisation.cpp. A detector within the grid is normalised by
+ * interpolating in the logarithms of frequency and bandwidth: linearly
+ * between the two nearest columns and by cubic polynomial between the
+ * four nearest rows.
+ */
+class NormalisationTable {
+public:
+    /*! The result of normalising the detector at one point of a table */
+    struct Entry {
+        parameter_t ratio;  /*!< Ratio of the search normalised frequency
+                                 to the specified frequency, or 0 if the
+                                 search failed */
+        parameter_t aReal;  /*!< Real part of the amplitude scale factor */
+        parameter_t aImag;  /*!< Imaginary part of the amplitude scale factor */
+        parameter_t iScale; /*!< Scaling factor for imaginary part */
+    };
+
+    /*! Numerical methods which are tabulated */
+    static const int methods[];
+    /*! Frequency normalisations which are tabulated */
+    static const int freqNormalizations[];
+    /*! Sample rates which are tabulated */
+    static const parameter_t sampleRates[];
+    /*! Number of tables: one per method, frequency normalisation and
+     *  sample rate, in that order */
+    static constexpr std::size_t numTables { 2*2*2 };
+
+    /*! Damping of the tabulated detectors */
+    static constexpr parameter_t damping { 0.0001 };
+
+    /*! Frequency of the first column of each table (Hz) */
+    static constexpr parameter_t lowestFrequency { 16. };
+    /*! Columns per octave */
+    static constexpr std::size_t perOctave { 8 };
+    /*! Number of columns, reaching beyond 4.8kHz */
+    static constexpr std::size_t numFrequencies { 66 };
+    /*! Number of rows */
+    static constexpr std::size_t numBandwidths { 10 };
+    /*! Bandwidth of each row (Hz) */
+    static const parameter_t bandwidths[numBandwidths];
+
+    /*! Frequency of a column
+     * \param k Column number
+     * \return Frequency (Hz) */
+    static parameter_t frequency(const std::size_t k)
+    {
+        return lowestFrequency * std::exp2(static_cast<parameter_t>(k) / perOctave);
+    }
+
+    /*! Find the table for a method, frequency normalisation and sample rate
+     * \param features Method and normalisations, as for DetectorBank
+     * \param sr Sample rate
+     * \return Table number, or -1 if there is no such table */
+    static int table(const int features, const parameter_t sr);
+
+    /*!
+     * Look up the result of normalising a detector.
+     * \param key Parameters of the detector, as for NormalisationCache
+     * \param value Set to the result if the detector is within a table
+     * \return true if the detector is within a table
+     */
+    static bool find(const NormalisationCache::Key& key,
+                     NormalisationCache::Value& value);
+
+    /*! The tables, from normalisation_values.inc */
+    static const Entry entries[numTables][numBandwidths][numFrequencies];
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "pcmconverter.h"
+
+void PCMConverter::convert(const inputSample_t* pcm, const std::size_t numFrames,
+                           const std::size_t numChannels, inputSample_t* mono)
+{
+    downmix(pcm, numFrames, numChannels, 1, mono);
+}
+
+void PCMConverter::convert(const std::int16_t* pcm, const std::size_t numFrames,
+                           const std::size_t numChannels, inputSample_t* mono)
+{
+    downmix(pcm, numFrames, numChannels, 1.f/32768, mono);
+}
+
+void PCMConverter::convert(const std::int32_t* pcm, const std::size_t numFrames,
+                           const std::size_t numChannels, inputSample_t* mono,
+                           const unsigned bits)
+{
+    if (bits != 24 && bits != 32)
+        throw std::invalid_argument("PCM samples should have 24 or 32 bits.");
+    downmix(pcm, numFrames, numChannels, bits == 24 ? 1.f/8388608 : 1.f/2147483648, mono);
+}
+
+template <typename Sample>
+void PCMConverter::downmix(const Sample* pcm, const std::size_t numFrames,
+                           const std::size_t numChannels, const inputSample_t scale,
+                           inputSample_t* mono)
+{
+    if (numChannels == 0)
+        throw std::invalid_argument("PCM audio should have at least one channel.");
+
+    const inputSample_t s {scale / numChannels};
+
+    // Mono and stereo have loops of their own, whose stride is known
+    auto convert {
+        [numChannels, s](const Sample* p, const std::size_t count, inputSample_t* out) {
+            if (numChannels == 1)
+                for (std::size_t k {0}; k < count; k++)
+                    out[k] = inputSample_t(p[k]) * s;
+            else if (numChannels == 2)
+                for (std::size_t k {0}; k < count; k++)
+                    out[k] = (inputSample_t(p[2*k]) + inputSample_t(p[2*k+1])) * s;
+            else
+                for (std::size_t k {0}; k < count; k++) {
+                    inputSample_t sum {0};
+                    for (std::size_t c {0}; c < numChannels; c++)
+                        sum += inputSample_t(p[k*numChannels + c]);
+                    out[k] = sum * s;
+                }
+        }
+    };
+
+    // Whole blocks are converted into a local array, so the loops are of
+    // a fixed length and can't write to the input, and are vectorised
+    std::size_t i {0};
+    for ( ; i + block <= numFrames; i += block) {
+        inputSample_t frames[block];
+        convert(pcm + i*numChannels, block, frames);
+        std::copy(frames, frames + block, mono + i);
+    }
+    convert(pcm + i*numChannels, numFrames - i, mono + i);
+}
@@ -0,0 +1,70 @@
+#ifndef _PCMCONVERTER_H_
+#define _PCMCONVERTER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "detectortypes.h"
+
+/*! Convert interleaved PCM audio of one or more channels to the mono
+ *  floating point samples read by the detectors.
+ *
+ *  Integer samples are scaled to lie in [-1, 1), and the channels of
+ *  each frame are averaged, in a single pass over the input which the
+ *  compiler can vectorise. Any gain is applied by the detectors as they
+ *  read the converted samples, so it isn't applied here.
+ */
+class PCMConverter {
+public:
+    /*! Average the channels of floating point audio
+     *  \param pcm Interleaved samples, numFrames*numChannels of them
+     *  \param numFrames Number of frames
+     *  \param numChannels Number of channels
+     *  \param mono Output array of numFrames samples
+     *  \throw std::invalid_argument PCM audio should have at least one channel.
+     */
+    static void convert(const inputSample_t* pcm, const std::size_t numFrames,
+                        const std::size_t numChannels, inputSample_t* mono);
+    /*! Convert 16-bit audio
+     *  \param pcm Interleaved samples, numFrames*numChannels of them
+     *  \param numFrames Number of frames
+     *  \param numChannels Number of channels
+     *  \param mono Output array of numFrames samples
+     *  \throw std::invalid_argument PCM audio should have at least one channel.
+     */
+    static void convert(const std::int16_t* pcm, const std::size_t numFrames,
+                        const std::size_t numChannels, inputSample_t* mono);
+    /*! Convert 24 or 32-bit audio held in 32-bit integers
+     *  \param pcm Interleaved samples, numFrames*numChannels of them
+     *  \param numFrames Number of frames
+     *  \param numChannels Number of channels
+     *  \param mono Output array of numFrames samples
+     *  \param bits Number of significant bits of each sample: 32, or 24
+     *  for 24-bit samples in the low 24 bits of each integer. (24-bit
+     *  samples in the high 24 bits are converted as 32-bit samples.)
+     *  \throw std::invalid_argument PCM samples should have 24 or 32 bits.
+     *  \throw std::invalid_argument PCM audio should have at least one channel.
+     */
+    static void convert(const std::int32_t* pcm, const std::size_t numFrames,
+                        const std::size_t numChannels, inputSample_t* mono,
+                        const unsigned bits = 32);
+
+private:
+    /*! Number of frames converted at a time */
+    static constexpr std::size_t block {16};
+
+    /*! Scale the samples of each frame and average them
+     *  \param pcm Interleaved samples
+     *  \param numFrames Number of frames
+     *  \param numChannels Number of channels
+     *  \param scale Scale applied to each sample
+     *  \param mono Output array
+     *  \throw std::invalid_argument PCM audio should have at least one channel.
+     */
+    template <typename Sample>
+    static void downmix(const Sample* pcm, const std::size_t numFrames,
+                        const std::size_t numChannels, const inputSample_t scale,
+                        inputSample_t* mono);
+};
+
+#endif
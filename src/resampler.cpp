@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include "resampler.h"
+
+Resampler::Resampler(const parameter_t inputRate, const parameter_t outputRate)
+{
+    ratio(inputRate, outputRate, up, down);
+
+    // The filter is cut off below the Nyquist frequency of the input
+    // or of the output, whichever is lower; as a fraction of the former
+    const double c { cutoff * std::min(1.0, static_cast<double>(up) / down) };
+    half = up == down ? 0 : static_cast<std::size_t>(std::ceil(zeroCrossings / c));
+
+    // Phase p of the filter gives the output sample p/up of an input
+    // sample after input sample 0, from input samples -half to half
+    const std::size_t taps {2*half + 1};
+    const double width {half + 1.0};
+    kernel.resize(up * taps);
+    for (std::size_t p {0}; p < up; p++) {
+        inputSample_t* phaseTaps {kernel.data() + p*taps};
+        for (std::size_t i {0}; i < taps; i++) {
+            const double t {static_cast<double>(p)/up + half - static_cast<double>(i)};
+            const double ideal {t == 0 ? c : std::sin(M_PI*c*t) / (M_PI*t)};
+            const double window {
+                0.42 + 0.5*std::cos(M_PI*t/width) + 0.08*std::cos(2.*M_PI*t/width)
+            };
+            phaseTaps[i] = ideal * window;
+        }
+        // Each phase passes 0Hz with unit gain
+        const double sum {std::accumulate(phaseTaps, phaseTaps + taps, 0.0)};
+        for (std::size_t i {0}; i < taps; i++)
+            phaseTaps[i] /= sum;
+    }
+
+    reset();
+}
+
+void Resampler::ratio(const parameter_t inputRate, const parameter_t outputRate,
+                      std::size_t& up, std::size_t& down)
+{
+    const long long in {std::llround(inputRate)}, out {std::llround(outputRate)};
+    if (in <= 0 || out <= 0)
+        throw std::invalid_argument("Sample rates should be positive.");
+
+    // Reduce the rates to their lowest terms by Euclid's algorithm
+    long long common {in};
+    for (long long r {out}; r != 0; ) {
+        const long long next {common % r};
+        common = r;
+        r = next;
+    }
+    up = out / common;
+    down = in / common;
+}
+
+std::size_t Resampler::latency() const
+{
+    return (half*up + down - 1) / down;
+}
+
+std::size_t Resampler::maxOutput(const std::size_t blockSize) const
+{
+    return (blockSize*up + down - 1) / down;
+}
+
+void Resampler::reset()
+{
+    // Before the signal starts its samples are zero
+    samples.assign(half, 0);
+    received = 0;
+    phase = 0;
+    written = 0;
+}
+
+std::size_t Resampler::push(const inputSample_t* input, const std::size_t blockSize,
+                            inputSample_t* output)
+{
+    samples.insert(samples.end(), input, input + blockSize);
+    received += blockSize;
+    return run(output, std::numeric_limits<std::size_t>::max());
+}
+
+std::size_t Resampler::flush(inputSample_t* output)
+{
+    // The output ends with the input, whose samples after its end are zero
+    samples.insert(samples.end(), half, 0);
+    const std::size_t count {run(output, (received*up + down - 1) / down)};
+    reset();
+    return count;
+}
+
+std::size_t Resampler::run(inputSample_t* output, const std::size_t end)
+{
+    const std::size_t taps {2*half + 1};
+    std::size_t first {0}, count {0};
+
+    while (first + taps <= samples.size() && written < end) {
+        const inputSample_t* x {samples.data() + first};
+        const inputSample_t* h {kernel.data() + phase*taps};
+        inputSample_t y {0};
+        for (std::size_t i {0}; i < taps; i++)
+            y += h[i] * x[i];
+        output[count++] = y;
+        written++;
+
+        phase += down;
+        first += phase / up;
+        phase %= up;
+    }
+
+    // Keep the input from half samples before the next output
+    samples.erase(samples.begin(), samples.begin() + std::min(first, samples.size()));
+    return count;
+}
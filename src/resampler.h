@@ -0,0 +1,100 @@
+#ifndef _RESAMPLER_H_
+#define _RESAMPLER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "detectortypes.h"
+
+/*! Convert a signal from one sample rate to another, in blocks.
+ *
+ *  The rates are related by the ratio of two whole numbers, up/down, by
+ *  which the signal is notionally upsampled then downsampled. Each output
+ *  sample is found directly from the input samples about it, with one of
+ *  up phases of a Blackman-windowed sinc filter (a polyphase filter) cut
+ *  off below the lower of the two Nyquist frequencies. The filter is
+ *  centred on each output sample, so the output isn't delayed but its
+ *  last latency() samples are only written by flush().
+ *
+ *  The state of the filter is kept from one block to the next, so the
+ *  output is the same however the input is divided into blocks.
+ */
+class Resampler {
+public:
+    /*! Construct a Resampler
+     *  \param inputRate Sample rate of the input
+     *  \param outputRate Sample rate of the output
+     *  \throw std::invalid_argument if either rate is not positive
+     */
+    Resampler(const parameter_t inputRate, const parameter_t outputRate);
+
+    /*! Number of output samples of a signal which are only written by
+     *  flush() */
+    std::size_t latency() const;
+
+    /*! Largest number of output samples written by push() for a block
+     *  \param blockSize Number of input samples in the block
+     */
+    std::size_t maxOutput(const std::size_t blockSize) const;
+
+    /*! Resample the next block of the signal
+     *  \param input Block of input samples
+     *  \param blockSize Number of samples in the block
+     *  \param output Array of at least maxOutput(blockSize) samples into
+     *         which the output is written
+     *  \return Number of output samples written
+     */
+    std::size_t push(const inputSample_t* input, const std::size_t blockSize,
+                     inputSample_t* output);
+
+    /*! End the signal, writing the rest of the output, and start a new one
+     *  \param output Array of at least latency() samples into which the
+     *         output is written
+     *  \return Number of output samples written
+     */
+    std::size_t flush(inputSample_t* output);
+
+    /*! Start a new signal */
+    void reset();
+
+    /*! Find the ratio of two sample rates in its lowest terms
+     *  \param inputRate Sample rate of the input
+     *  \param outputRate Sample rate of the output
+     *  \param up Set to the factor by which the input is upsampled
+     *  \param down Set to the factor by which it is then downsampled
+     */
+    static void ratio(const parameter_t inputRate, const parameter_t outputRate,
+                      std::size_t& up, std::size_t& down);
+
+    /*! Zero crossings of the filter's sinc either side of its centre */
+    static constexpr std::size_t zeroCrossings { 16 };
+    /*! Cut-off of the filter as a fraction of the lower Nyquist frequency */
+    static constexpr double cutoff { 0.9 };
+
+protected:
+    std::size_t up;     /*!< Upsampling factor */
+    std::size_t down;   /*!< Downsampling factor */
+    std::size_t half;   /*!< Input samples either side of the centre of
+                             the filter */
+    /*! Taps of each phase of the filter, 2*half+1 per phase */
+    std::vector<inputSample_t> kernel;
+    /*! Input from half samples before that of the next output sample */
+    std::vector<inputSample_t> samples;
+    /*! Input samples received since the signal started */
+    std::size_t received;
+    /*! Phase of the next output sample: its time is (first + half +
+     *  phase/up) input samples, where first is that of samples[0] */
+    std::size_t phase;
+    /*! Output samples written since the signal started */
+    std::size_t written;
+
+    /*! Write output samples while their input is available
+     *  \param output Array into which the output is written
+     *  \param end Number of output samples of the whole signal, beyond
+     *         which none is written
+     *  \return Number of output samples written
+     */
+    std::size_t run(inputSample_t* output, const std::size_t end);
+};
+
+#endif
@@ -1,14 +1,71 @@
+#include <algorithm>
+#include <climits>
 #include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 
+#ifdef __linux__
+#   include <linux/futex.h>
+#   include <pthread.h>
+#   include <sched.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
 #include "thread_pool.h"
 
 //#include <iostream>
 
-ThreadPool::ThreadPool(std::size_t numThreads)
+namespace {
+    // Let a spinning thread's sibling hyperthread run
+    inline void relax()
+    {
+#       if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#       elif defined(__aarch64__)
+            asm volatile("yield");
+#       endif
+    }
+
+    // Sleep until the value of a word changes from seen, or wake the
+    // threads sleeping on it. Without futexes the thread just yields.
+    void futexWait(std::atomic<std::uint32_t>& word, const std::uint32_t seen)
+    {
+#       ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+                    FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+#       else
+            (void) word; (void) seen;
+            std::this_thread::yield();
+#       endif
+    }
+
+    void futexWake(std::atomic<std::uint32_t>& word)
+    {
+#       ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+                    FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#       else
+            (void) word;
+#       endif
+    }
+}
+
+// spinTime is used by reference, so needs a definition before C++17
+constexpr std::chrono::microseconds ThreadPool::spinTime;
+
+ThreadPool::ThreadPool(std::size_t numThreads, const bool lowLatency)
     : remain(0)
+    , shared(nullptr)
+    , sharedParams(nullptr)
+    , runners(0)
+    , lowLatency(lowLatency)
+    , spin(false)
+    , generation(0)
+    , busy(0)
+    , sleepers(0)
+    , stopping(false)
     , threads(numThreads ? numThreads : std::thread::hardware_concurrency())
 {
     states = std::unique_ptr<enum state[]> {
@@ -19,15 +76,60 @@ ThreadPool::ThreadPool(std::size_t numThreads)
     };
     for (std::size_t i {0} ; i < threads ; i++)
         states[i] = waiting;
+    runs = std::unique_ptr<Run[]> { new Run[threads] };
+    runArgs = std::unique_ptr<void*[]> { new void*[threads] };
+    for (std::size_t i {0} ; i < threads ; i++)
+        runArgs[i] = &runs[i];
     workers = std::unique_ptr<std::thread[]> {
         new std::thread[threads]
     };
+
+    if (lowLatency) {
+        // The caller is the first thread. The others are pinned to
+        // CPUs of their own, if there are enough, so that they can spin
+#       ifdef __linux__
+            cpu_set_t allowed;
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 &&
+                std::size_t(CPU_COUNT(&allowed)) >= threads)
+                spin = true;
+#       else
+            spin = threads <= std::thread::hardware_concurrency();
+#       endif
+        for (std::size_t i {1} ; i < threads ; i++) {
+            workers[i] = std::thread(&ThreadPool::spinner, this, i);
+#           ifdef __linux__
+                if (!spin)
+                    continue;
+                // The i'th of the allowed CPUs
+                std::size_t cpu {0};
+                for (std::size_t n {0} ; ; cpu++)
+                    if (CPU_ISSET(cpu, &allowed) && n++ == i)
+                        break;
+                cpu_set_t pin;
+                CPU_ZERO(&pin);
+                CPU_SET(cpu, &pin);
+                pthread_setaffinity_np(workers[i].native_handle(), sizeof(pin), &pin);
+#           endif
+        }
+        return;
+    }
+
     for (std::size_t i {0} ; i < threads ; i++) 
         workers[i] = std::thread(&ThreadPool::dispatcher, this, i);
 }
     
 ThreadPool::~ThreadPool()
 {
+    if (lowLatency) {
+        stopping = true;
+        generation++;
+        futexWake(generation);
+        for (std::size_t i {1} ; i < threads ; i++)
+            workers[i].join();
+        return;
+    }
+
+
     // Tell all the threads to die
     std::unique_lock<std::mutex> lk(m);
     cv.wait(lk, [this]{ return remain==0; });
@@ -53,6 +155,11 @@ void ThreadPool::manifold(delegate_t delegate,
                          void** params,
                          std::size_t jobs)
 {
+    if (lowLatency) {
+        share(delegate, params, jobs);
+        return;
+    }
+
     this->params = params;
     this->delegate = delegate;
     remain = 0;
@@ -107,3 +214,156 @@ void ThreadPool::dispatcher(int id)
     }
 }
 
+void ThreadPool::share(const delegate_t& delegate,
+                       void** params,
+                       std::size_t jobs,
+                       const double* costs)
+{
+    runners = std::min(jobs, threads);
+    if (runners == 0)
+        return;
+    shared = &delegate;
+    sharedParams = params;
+
+    // Each job goes to the run in which the middle of its cost falls
+    // when the total cost is divided equally between the runs
+    auto cost { [costs](std::size_t job) { return costs ? costs[job] : 1.; } };
+    double total {0};
+    for (std::size_t j {0} ; j < jobs ; j++)
+        total += cost(j);
+    double done {0};
+    for (std::size_t t {0}, first {0} ; t < runners ; t++) {
+        std::size_t end {first};
+        if (t+1 == runners)
+            end = jobs;
+        else
+            while (end < jobs && (done + cost(end)/2) * runners < total * (t+1))
+                done += cost(end++);
+        runs[t].range = std::uint64_t(first) << 32 | end;
+        first = end;
+    }
+
+    if (lowLatency)
+        shareLowLatency();
+    else
+        manifold([this](void* run) { runShare(static_cast<Run*>(run) - runs.get()); },
+                 runArgs.get(), runners);
+}
+
+void ThreadPool::runShare(const std::size_t own)
+{
+    std::size_t job;
+    while (take(runs[own], false, job))
+        (*shared)(sharedParams[job]);
+    // Help whichever thread has most left to do
+    while (true) {
+        Run* victim {nullptr};
+        std::uint64_t most {0};
+        for (std::size_t t {0} ; t < runners ; t++) {
+            const std::uint64_t range {runs[t].range.load()};
+            const std::uint64_t next {range >> 32}, end {range & 0xffffffff};
+            const std::uint64_t left {end > next ? end - next : 0};
+            if (left > most) {
+                most = left;
+                victim = &runs[t];
+            }
+        }
+        if (!victim)
+            return;
+        if (take(*victim, true, job))
+            (*shared)(sharedParams[job]);
+    }
+}
+
+void ThreadPool::shareLowLatency()
+{
+    for (std::size_t i {0} ; i < threads ; i++)
+        exceptions[i] = nullptr;
+
+    // Every worker acknowledges every batch of jobs, even if it has no
+    // run of its own, so none of them can fall a batch behind
+    busy = threads - 1;
+    generation++;
+    if (sleepers > 0)
+        futexWake(generation);
+
+    try {
+        runShare(0);
+    } catch(...) {
+        exceptions[0] = std::current_exception();
+    }
+
+    // The delegate and parameters belong to the caller, so the workers
+    // must have finished with them before it returns
+    for (unsigned n {0} ; busy.load(std::memory_order_acquire) != 0 ; n++)
+        if (spin || n < 64)
+            relax();
+        else
+            std::this_thread::yield();
+
+    for (std::size_t i {0} ; i < threads ; i++)
+        if (exceptions[i])
+            std::rethrow_exception(exceptions[i]);
+}
+
+std::uint32_t ThreadPool::awaitJobs(const std::uint32_t seen)
+{
+    if (spin) {
+        const auto until { std::chrono::steady_clock::now() + spinTime };
+        for (unsigned n {1} ; ; n++) {
+            const std::uint32_t current {generation.load(std::memory_order_acquire)};
+            if (current != seen)
+                return current;
+            relax();
+            if (n % 64 == 0 && std::chrono::steady_clock::now() > until)
+                break;
+        }
+    }
+    // A worker counts itself as sleeping before it looks at generation
+    // for the last time, so a caller changing it either wakes the
+    // worker or is seen by it
+    while (true) {
+        sleepers++;
+        if (generation == seen)
+            futexWait(generation, seen);
+        sleepers--;
+        const std::uint32_t current {generation.load(std::memory_order_acquire)};
+        if (current != seen)
+            return current;
+    }
+}
+
+void ThreadPool::spinner(const std::size_t id)
+{
+    std::uint32_t seen {0};
+    while (true) {
+        seen = awaitJobs(seen);
+        if (stopping)
+            return;
+        if (id < runners) {
+            try {
+                runShare(id);
+            } catch(...) {
+                exceptions[id] = std::current_exception();
+            }
+        }
+        busy.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool ThreadPool::take(Run& run, const bool back, std::size_t& job)
+{
+    std::uint64_t range {run.range.load()};
+    while (true) {
+        const std::uint64_t next {range >> 32}, end {range & 0xffffffff};
+        if (next >= end)
+            return false;
+        const std::uint64_t taken {
+            back ? (next << 32 | (end-1)) : ((next+1) << 32 | end)
+        };
+        if (run.range.compare_exchange_weak(range, taken)) {
+            job = back ? end-1 : next;
+            return true;
+        }
+    }
+}
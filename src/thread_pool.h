@@ -1,6 +1,9 @@
 #ifndef _THREAD_POOL_H_
 #define _THREAD_POOL_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -29,6 +32,18 @@
  * given when the ThreadPool object is created. manifold()
  * does not return until all jobs are complete.
  * 
+ * Jobs of unequal cost may instead be passed to share(), which gives
+ * each thread a run of them and lets threads which finish their own
+ * runs take jobs from the others.
+ * 
+ * A pool made for low latency has workers which wait for jobs by
+ * spinning for a while, and then by sleeping on a futex, rather than on
+ * a condition variable. The thread calling share() or manifold() runs
+ * jobs too, and waits at a barrier for the workers to finish, so small
+ * batches of jobs are dispatched in a few microseconds and without any
+ * allocation. Each worker is pinned to a CPU of its own when there are
+ * enough of them, and only spins when it has one to itself.
+ * 
  * Threads are reused across calls to manifold(). When the ThreadPool
  * is destroyed, it closes down all threads and awaits their
  * proper termination.
@@ -69,6 +84,76 @@ protected:
      * their job packets
      */
     std::size_t remain;
+
+    /*!
+     * A run of jobs given to one thread by share(): the index of its
+     * next job in the high 32 bits and the index after its last job in
+     * the low 32 bits, so that a job is taken from either end by a
+     * single compare-and-swap. Each run has a cache line of its own.
+     */
+    struct alignas(64) Run {
+        std::atomic<std::uint64_t> range; /*!< Next and end of the run */
+    };
+    /*! Runs of the jobs passed to share(), one per thread */
+    std::unique_ptr<Run[]> runs;
+    /*! Pointers to each of the runs, passed to manifold() by share() */
+    std::unique_ptr<void*[]> runArgs;
+    /*!
+     * Take the job at the front (or back) of a run
+     * \param run The run
+     * \param back Whether to take the job at the back of the run
+     * \param job Set to the index of the job taken
+     * \return false if the run was empty
+     */
+    static bool take(Run& run, const bool back, std::size_t& job);
+    /*!
+     * Run the jobs of a run passed to share(), then help with the others
+     * \param own Index of the run
+     */
+    void runShare(const std::size_t own);
+    /*! The delegate of the jobs passed to share() */
+    const delegate_t* shared;
+    /*! Parameters of the jobs passed to share() */
+    void** sharedParams;
+    /*! Number of runs of the jobs passed to share() */
+    std::size_t runners;
+
+    /*! Whether the pool was made for low latency */
+    const bool lowLatency;
+    /*! Whether low-latency workers spin while waiting for jobs, which
+     *  they do if each can have a CPU of its own */
+    bool spin;
+    /*! How long a low-latency worker spins before sleeping: longer
+     *  than the time between blocks of a live stream of audio */
+    static constexpr std::chrono::microseconds spinTime {2000};
+    /*!
+     * Number of times jobs have been given to the low-latency workers.
+     * A worker runs its share of the jobs when this changes, and then
+     * acknowledges them through busy.
+     */
+    std::atomic<std::uint32_t> generation;
+    /*! Number of low-latency workers yet to acknowledge the jobs */
+    std::atomic<std::size_t> busy;
+    /*! Number of low-latency workers sleeping on generation */
+    std::atomic<std::size_t> sleepers;
+    /*! Set when low-latency workers are to exit */
+    bool stopping;
+    /*!
+     * Wait for jobs to be given to the low-latency workers
+     * \param seen The last value of generation seen by the worker
+     * \return The new value of generation
+     */
+    std::uint32_t awaitJobs(const std::uint32_t seen);
+    /*!
+     * Run the low-latency worker which runs the id'th run of jobs
+     * \param id Index of the worker, from 1; the caller is 0
+     */
+    void spinner(const std::size_t id);
+    /*!
+     * Give jobs passed to share() to the low-latency workers, run the
+     * first run of them, and wait for the workers to finish
+     */
+    void shareLowLatency();
     /*!
      * Convenience function: waits for a lock then deals with
      * any exceptions propagated from the threads
@@ -88,8 +173,14 @@ protected:
 public:
     /*! Number of threads in pool */
     const std::size_t threads;
-    /*! Construct a thread pool */
-    ThreadPool(std::size_t numThreads = 0);
+    /*!
+     * Construct a thread pool
+     * \param numThreads Number of threads, or 0 for the concurrency of
+     *                   the platform. In a low-latency pool this counts
+     *                   the thread calling share() or manifold().
+     * \param lowLatency Whether to make a low-latency pool
+     */
+    ThreadPool(std::size_t numThreads = 0, const bool lowLatency = false);
     /*!
      * Destroy the thread pool.
      * Waits for all executive threads to terminate.
@@ -106,10 +197,31 @@ public:
      * \param delegate The function each thread should call.
      * \param params   An array of pointers to parameters to pass.
      * \param jobs     Number of threads to run.
+     * In a low-latency pool the jobs are run as by share(), with equal
+     * costs.
      */
     void manifold(delegate_t delegate,
                   void** params,
                   std::size_t jobs);
+    /*!
+     * Execute a function for each of a number of jobs of unequal cost,
+     * on as many threads as there are jobs, up to the number in the
+     * pool. The jobs are divided in order into runs of about equal
+     * total cost, one per thread, so that jobs next to each other in
+     * params are run together. A thread which finishes its own run
+     * takes jobs one at a time from the back of whichever run has most
+     * left, so a thread which is slow or descheduled doesn't hold up
+     * the others. share() only returns when all jobs have been run.
+     * \param delegate The function to run for each job.
+     * \param params   An array of pointers to parameters to pass.
+     * \param jobs     Number of jobs.
+     * \param costs    Relative cost of each job, or null if they cost
+     *                 the same.
+     */
+    void share(const delegate_t& delegate,
+               void** params,
+               std::size_t jobs,
+               const double* costs = nullptr);
 };
 
 #endif
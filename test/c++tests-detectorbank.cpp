@@ -1,13 +1,56 @@
 #include <tap++.h>
 #include <string>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <fstream>
+#include <iterator>
 
 #include <detectorbank.h>
+#include <detectors.h>
+#include <detectorbatch.h>
+#include <detectorscan.h>
+#include <normalisationtable.h>
+#include <thread_pool.h>
 // #include <notedetector.h>  // Now resides in separate repo
 
 #include <iostream>
 
 using namespace TAP;
 
+// Every allocation made through operator new is counted, so that a test
+// can check that none are made while it runs. Neither operator is
+// inlined, or the compiler sees free() called on the result of new.
+static std::atomic<std::size_t> allocations {0};
+
+__attribute__((noinline)) void* operator new(std::size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size,
+                                             const std::nothrow_t&) noexcept {
+  allocations++;
+  return std::malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
 // int foo() {
 //   return 1;
 // }
@@ -25,11 +68,1065 @@ bool create() {
   }
 }
 
+// Run the same tone through the scalar and batched solvers and return
+// the largest difference relative to the peak scalar output.
+template <class Solver>
+double batch_vs_scalar(const parameter_t bw) {
+  const parameter_t sr {48000};
+  const parameter_t gain {25};
+  const std::size_t len {48000};
+  const parameter_t freqs[] {110., 220., 440., 880., 1500.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = gain * std::sin(2.*M_PI*440.*i/sr);
+
+  std::vector<std::unique_ptr<Solver>> scalar, batched;
+  for (std::size_t c {0}; c < chans; c++) {
+    scalar.emplace_back(new Solver(freqs[c], 0, 0.0001, sr, bw, gain));
+    batched.emplace_back(new Solver(freqs[c], 0, 0.0001, sr, bw, gain));
+  }
+
+  std::vector<discriminator_t> zs(chans*len), zb(chans*len);
+  AbstractDetector* group[chans];
+  discriminator_t* targets[chans];
+  const inputSample_t* sources[chans];
+
+  // Two calls, so that the state is carried across
+  for (std::size_t start : {std::size_t(0), len/3}) {
+    const std::size_t count {start ? len-start : len/3};
+    for (std::size_t c {0}; c < chans; c++) {
+      scalar[c]->processAudio(&zs[c*len+start], &tone[start], count);
+      group[c] = batched[c].get();
+      targets[c] = &zb[c*len+start];
+      sources[c] = &tone[start];
+    }
+    DetectorBatch<Solver>::process(group, targets, sources, chans, count);
+  }
+
+  double peak {0}, err {0};
+  for (std::size_t i {0}; i < chans*len; i++) {
+    peak = std::max(peak, std::abs(zs[i]));
+    err = std::max(err, std::abs(zs[i]-zb[i]));
+  }
+  return err/peak;
+}
+
+// Run a tone through a bank in double and then in single precision
+// and return the largest difference relative to the peak output.
+double single_vs_double(const DetectorBank::Features solver) {
+  const parameter_t sr {48000};
+  const std::size_t len {48000};
+  parameter_t freqs[] {55., 220., 440., 880., 3520.};
+  parameter_t bw[] {0., 0., 0., 0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = std::sin(2.*M_PI*440.*i/sr);
+
+  DetectorBank db(sr, tone.data(), len, 1, freqs, bw, chans,
+                  static_cast<DetectorBank::Features>(
+                    solver | DetectorBank::freq_unnormalized |
+                    DetectorBank::amp_unnormalized));
+
+  std::vector<discriminator_t> zd(chans*len);
+  std::vector<discriminatorf_t> zf(chans*len);
+  db.getZ(zd.data(), chans, len);
+  db.seek(0);
+  db.getZ(zf.data(), chans, len);
+
+  double peak {0}, err {0};
+  for (std::size_t i {0}; i < chans*len; i++) {
+    peak = std::max(peak, std::abs(zd[i]));
+    err = std::max(err, std::abs(zd[i] - discriminator_t(zf[i])));
+  }
+  return err/peak;
+}
+
+// Run a tone through Runge-Kutta and exact detectors at frequencies
+// low enough for the Runge-Kutta error to be negligible and return the
+// largest difference relative to the peak Runge-Kutta output.
+double exact_vs_rk4() {
+  const parameter_t sr {48000};
+  const parameter_t gain {25};
+  const std::size_t len {48000};
+  const parameter_t freqs[] {110., 440., 880.};
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = gain * std::sin(2.*M_PI*440.*i/sr);
+
+  std::vector<discriminator_t> zr(len), ze(len);
+  double peak {0}, err {0};
+  for (const parameter_t f : freqs) {
+    RK4Detector rk4(f, 0, 0.0001, sr, 0, gain);
+    ExactDetector exact(f, 0, 0.0001, sr, 0, gain);
+    rk4.processAudio(zr.data(), tone.data(), len);
+    exact.processAudio(ze.data(), tone.data(), len);
+    for (std::size_t i {0}; i < len; i++) {
+      peak = std::max(peak, std::abs(zr[i]));
+      err = std::max(err, std::abs(zr[i]-ze[i]));
+    }
+  }
+  return err/peak;
+}
+
+// Run a tone through a two-channel bank whose time range is divided
+// between eight threads and through the same bank run with one thread,
+// in two calls to getZ() so that the state is carried across. Return the
+// largest difference relative to the peak output.
+double scan_vs_serial(const DetectorBank::Features solver) {
+  const parameter_t sr {48000};
+  const std::size_t len {10*DetectorScan<RK4Detector>::minBlock + 123};
+  parameter_t freqs[] {440., 445.};
+  parameter_t bw[] {0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = std::sin(2.*M_PI*440.*i/sr);
+
+  const DetectorBank::Features features {
+    static_cast<DetectorBank::Features>(
+      solver | DetectorBank::freq_unnormalized | DetectorBank::amp_unnormalized)
+  };
+  DetectorBank scanned(sr, tone.data(), len, 8, freqs, bw, chans, features);
+  DetectorBank serial(sr, tone.data(), len, 1, freqs, bw, chans, features);
+
+  std::vector<discriminator_t> zs(chans*len), zp(chans*len);
+  const std::size_t first {len/3};
+  serial.getZ(zs.data(), chans, first);
+  serial.getZ(zs.data()+chans*first, chans, len-first);
+  scanned.getZ(zp.data(), chans, first);
+  scanned.getZ(zp.data()+chans*first, chans, len-first);
+
+  double peak {0}, err {0};
+  for (std::size_t i {0}; i < chans*len; i++) {
+    peak = std::max(peak, std::abs(zs[i]));
+    err = std::max(err, std::abs(zs[i]-zp[i]));
+  }
+  return err/peak;
+}
+
+// Scan a two-channel bank with eight threads over blocks of input
+// long enough for two, three and four blocks per channel. Return true
+// if no call to getZ() allocates.
+bool scan_allocations() {
+  const parameter_t sr {48000};
+  const std::size_t minBlock {DetectorScan<RK4Detector>::minBlock};
+  const std::size_t len {9*minBlock + 3};
+  parameter_t freqs[] {440., 445.};
+  parameter_t bw[] {0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = std::sin(2.*M_PI*440.*i/sr);
+
+  DetectorBank db(sr, tone.data(), len, 8, freqs, bw, chans,
+                  static_cast<DetectorBank::Features>(
+                    DetectorBank::runge_kutta | DetectorBank::freq_unnormalized |
+                    DetectorBank::amp_unnormalized));
+  std::vector<discriminator_t> z(chans*(4*minBlock + 2));
+
+  const std::size_t before {allocations};
+  for (std::size_t n : {2*minBlock, 3*minBlock + 1, 4*minBlock + 2})
+    db.getZ(z.data(), chans, n);
+  return allocations == before;
+}
+
+// Run a tone through a two-channel bank with getZ() followed by absZ()
+// and again with getAbsZ(), keeping a running maximum of each channel
+// over two calls. With eight threads linear detectors are scanned.
+// Return the largest difference in magnitude or maximum relative to
+// the peak output.
+double absz_vs_getz(const DetectorBank::Features solver, const int threads) {
+  const parameter_t sr {48000};
+  const std::size_t len {3*DetectorScan<RK4Detector>::minBlock + 45};
+  parameter_t freqs[] {440., 445.};
+  parameter_t bw[] {0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = std::sin(2.*M_PI*440.*i/sr);
+
+  DetectorBank db(sr, tone.data(), len, threads, freqs, bw, chans,
+                  static_cast<DetectorBank::Features>(
+                    solver | DetectorBank::freq_unnormalized |
+                    DetectorBank::amp_normalized));
+
+  std::vector<discriminator_t> z(chans*len);
+  std::vector<result_t> ref(chans*len), r(chans*len);
+  db.getZ(z.data(), chans, len);
+  const result_t peak { db.absZ(ref.data(), chans, len, z.data()) };
+
+  db.seek(0);
+  result_t maxima[chans] {};
+  const std::size_t first {len/3};
+  db.getAbsZ(r.data(), chans, first, 0, maxima);
+  db.getAbsZ(r.data()+chans*first, chans, len-first, 0, maxima);
+
+  // The two calls lay the output out as in two calls to getZ()
+  double err {0};
+  for (std::size_t c {0}; c < chans; c++) {
+    result_t mx {0};
+    for (std::size_t i {0}; i < len; i++) {
+      const result_t a { i < first ? r[c*first+i] : r[chans*first + c*(len-first) + i-first] };
+      err = std::max(err, std::abs(a - ref[c*len+i]));
+      mx = std::max(mx, ref[c*len+i]);
+    }
+    err = std::max(err, std::abs(maxima[c] - mx));
+  }
+  return err/peak;
+}
+
+// Run a tone through a two-channel bank with getZ() and with
+// getDecimatedZ() and both forms of getPooledZ(), over a length which is
+// not a whole number of hops. With eight threads linear detectors are
+// scanned. Return the largest difference from the output of getZ()
+// decimated or pooled afterwards, relative to the peak output.
+double pooled_vs_getz(const DetectorBank::Features solver, const int threads) {
+  const parameter_t sr {48000};
+  const std::size_t hop {64};
+  const std::size_t len {3*DetectorScan<RK4Detector>::minBlock + 45};
+  const std::size_t hops {(len+hop-1)/hop};
+  parameter_t freqs[] {440., 445.};
+  parameter_t bw[] {0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = std::sin(2.*M_PI*440.*i/sr);
+
+  DetectorBank db(sr, tone.data(), len, threads, freqs, bw, chans,
+                  static_cast<DetectorBank::Features>(
+                    solver | DetectorBank::freq_unnormalized |
+                    DetectorBank::amp_normalized));
+
+  std::vector<discriminator_t> z(chans*len), zd(chans*hops);
+  std::vector<result_t> mx(chans*hops), mp(chans*hops);
+  db.getZ(z.data(), chans, len);
+  db.seek(0);
+  const bool complete { db.getDecimatedZ(zd.data(), chans, hops, hop) == int(hops) };
+  db.seek(0);
+  db.getPooledZ(mx.data(), chans, hops, hop, DetectorBank::max_abs);
+  db.seek(0);
+  db.getPooledZ(mp.data(), chans, hops, hop, DetectorBank::mean_power);
+
+  double peak {0}, err {0};
+  for (std::size_t c {0}; c < chans; c++)
+    for (std::size_t k {0}; k < hops; k++) {
+      const discriminator_t* zk { &z[c*len + k*hop] };
+      const std::size_t n { std::min(hop, len - k*hop) };
+      result_t m {0}, p {0};
+      for (std::size_t i {0}; i < n; i++) {
+        m = std::max(m, std::abs(zk[i]));
+        p += std::norm(zk[i]);
+      }
+      peak = std::max(peak, m);
+      err = std::max(err, std::abs(zd[c*hops+k] - zk[0]));
+      err = std::max(err, std::abs(mx[c*hops+k] - m));
+      err = std::max(err, std::sqrt(std::abs(mp[c*hops+k] - p/n)));
+    }
+  return complete ? err/peak : 1.;
+}
+
+// Construct a normalised bank, then construct it again after the
+// normalisation cache has been reread from its file. Return true if the
+// first bank wrote an entry for each channel to the file, the second
+// found every entry in the file (so added none) and the banks' outputs
+// are identical. The damping is not that of the normalisation tables,
+// so the detectors are normalised by simulation.
+bool cache_reuse() {
+  const std::string path {"c++tests-normalisation-cache"};
+  const parameter_t sr {48000}, d {0.0002};
+  const std::size_t len {4800};
+  parameter_t freqs[] {220., 440., 880.};
+  parameter_t bw[] {0., 5., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  const DetectorBank::Features features {
+    static_cast<DetectorBank::Features>(
+      DetectorBank::runge_kutta | DetectorBank::search_normalized |
+      DetectorBank::amp_normalized)
+  };
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = std::sin(2.*M_PI*440.*i/sr);
+
+  auto contents {
+    [&path]() {
+      std::ifstream file(path);
+      return std::string(std::istreambuf_iterator<char>(file),
+                         std::istreambuf_iterator<char>());
+    }
+  };
+
+  std::vector<discriminator_t> z[2];
+  std::string written[2];
+  std::remove(path.c_str());
+  for (int run {0}; run < 2; run++) {
+    DetectorBank::setNormalisationCache(path);
+    DetectorBank db(sr, tone.data(), len, 1, freqs, bw, chans, features, d);
+    written[run] = contents();
+    z[run].resize(chans*len);
+    db.getZ(z[run].data(), chans, len);
+  }
+  DetectorBank::setNormalisationCache("");
+  std::remove(path.c_str());
+
+  // A header line then one line per channel
+  return std::size_t(std::count(written[0].begin(), written[0].end(), '\n')) == chans + 1 &&
+         written[1] == written[0] && z[0] == z[1];
+}
+
+// Construct the same normalised bank with one thread and with eight,
+// discarding cached normalisation results in between. Return true if
+// the banks' outputs are identical, so the detectors made concurrently
+// are in channel order and normalised as they would be serially.
+bool parallel_construction() {
+  const parameter_t sr {48000};
+  const std::size_t len {4800};
+  parameter_t freqs[] {110., 220., 330., 440., 660., 880., 1320.};
+  parameter_t bw[] {0., 5., 0., 5., 0., 5., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  const DetectorBank::Features features {
+    static_cast<DetectorBank::Features>(
+      DetectorBank::runge_kutta | DetectorBank::search_normalized |
+      DetectorBank::amp_normalized)
+  };
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = std::sin(2.*M_PI*440.*i/sr);
+
+  std::vector<discriminator_t> z[2];
+  const int threads[] {1, 8};
+  for (int run {0}; run < 2; run++) {
+    DetectorBank::setNormalisationCache("");
+    DetectorBank db(sr, tone.data(), len, threads[run], freqs, bw, chans, features);
+    z[run].resize(chans*len);
+    db.getZ(z[run].data(), chans, len);
+  }
+  return z[0] == z[1];
+}
+
+// Normalise the amplitude of detectors with the default tolerance and
+// with a negative one, which runs the tone for the full 60 seconds.
+// Return the largest relative difference in the magnitudes of the
+// scale factors, or 1 if the early-terminating run wasn't shorter.
+template <class Solver>
+double early_amplitude_normalize(const parameter_t bw) {
+  const parameter_t sr {48000}, d {0.0001}, gain {25};
+  double err {0};
+  for (const parameter_t f : {110., 1500.}) {
+    Solver early(f, 0, d, sr, bw, gain), full(f, 0, d, sr, bw, gain);
+    if (early.amplitudeNormalize(gain) >= full.amplitudeNormalize(gain, -1))
+      return 1;
+    const NormalisationCache::Value e {early.getNormalisation()};
+    const NormalisationCache::Value r {full.getNormalisation()};
+    err = std::max(err, std::abs(std::abs(e.aScale) - std::abs(r.aScale)) / std::abs(r.aScale));
+    err = std::max(err, std::abs(std::abs(e.iScale) - std::abs(r.iScale)) / std::abs(r.iScale));
+  }
+  return err;
+}
+
+// Search normalise detectors over the full range, and over the narrow
+// range used when the correction is expected from neighbouring detectors
+// (here off-centre by a few cents). Return the largest difference, in
+// cents, between the frequencies found, or 1200 if either search failed
+// or a range not spanning the maximum response was not rejected.
+template <class Solver>
+double warm_search_normalize() {
+  const parameter_t sr {48000}, d {0.0001}, gain {25};
+  const parameter_t range {1.0046316744020538}, offset {1.0017};
+  double err {0};
+  for (const parameter_t f : {110., 880., 2000.}) {
+    Solver full(f, 0, d, sr, 0, gain), warm(f, 0, d, sr, 0, gain), miss(f, 0, d, sr, 0, gain);
+    if (!full.searchNormalize(0.92, 1.08, 3.0, gain) ||
+        !warm.searchNormalize(offset/range, offset*range, 3.0, gain) ||
+        miss.searchNormalize(1.01, 1.02, 3.0, gain) || miss.getW() != 2*M_PI*f)
+      return 1200;
+    err = std::max(err, std::abs(1200*std::log2(warm.getW()/full.getW())));
+  }
+  return err;
+}
+
+// Normalise linear detectors analytically and by running test tones.
+// Return the largest relative difference in the magnitudes of the
+// amplitude scale factors, or 1 if the frequencies found differ by more
+// than a tenth of a cent.
+template <class Solver>
+double analytic_normalize() {
+  const parameter_t sr {48000}, d {0.0001}, gain {25};
+  double err {0};
+  for (const parameter_t f : {110., 220.}) {
+    Solver simulated(f, 0, d, sr, 0, gain), analytic(f, 0, d, sr, 0, gain);
+    if (!simulated.isLinear() ||
+        !simulated.searchNormalize(0.92, 1.08, 3.0, gain) ||
+        !analytic.analyticSearchNormalize(0.92, 1.08) ||
+        std::abs(1200*std::log2(analytic.getW()/simulated.getW())) > 0.1)
+      return 1;
+    simulated.amplitudeNormalize(gain, -1);
+    analytic.analyticAmplitudeNormalize(gain);
+    const NormalisationCache::Value s {simulated.getNormalisation()};
+    const NormalisationCache::Value a {analytic.getNormalisation()};
+    err = std::max(err, std::abs(std::abs(a.aScale) - std::abs(s.aScale)) / std::abs(s.aScale));
+    err = std::max(err, std::abs(std::abs(a.iScale) - std::abs(s.iScale)) / std::abs(s.iScale));
+  }
+  return err;
+}
+
+// Look up the normalisation of nonlinear detectors between the points
+// of the tables, and normalise them by running test tones. Return the
+// largest relative difference in the magnitudes of the scale factors,
+// or 1 if a detector isn't tabulated or the frequencies found differ by
+// more than half a cent.
+template <class Solver>
+double tabulated_normalize() {
+  const parameter_t sr {48000}, d {0.0001}, gain {25};
+  const int features {
+    Solver::method | DetectorBank::search_normalized | DetectorBank::amp_normalized
+  };
+  double err {0};
+  for (const parameter_t f : {150., 700.})
+    for (const parameter_t bw : {4., 12.}) {
+      NormalisationCache::Value t;
+      if (!NormalisationTable::find(NormalisationCache::Key {features, sr, f, bw, 0, d, gain}, t))
+        return 1;
+      Solver simulated(f, 0, d, sr, bw, gain);
+      simulated.searchNormalize(0.92, 1.08, 3.0, gain);
+      simulated.amplitudeNormalize(gain);
+      const NormalisationCache::Value s {simulated.getNormalisation()};
+      if (std::abs(1200*std::log2(t.w/s.w)) > 0.5)
+        return 1;
+      err = std::max(err, std::abs(std::abs(t.aScale) - std::abs(s.aScale)) / std::abs(s.aScale));
+      err = std::max(err, std::abs(std::abs(t.iScale) - std::abs(s.iScale)) / std::abs(s.iScale));
+    }
+  return err;
+}
+
+// Construct a bank whose normalisation is deferred and run it at once,
+// then wait for the normalisation. Return true if progress was reported
+// for every detector and, once normalised, the bank's output is identical
+// to that of a bank normalised when it was constructed.
+bool deferred_normalisation() {
+  const parameter_t sr {48000}, d {0.0002};
+  const std::size_t len {4800};
+  parameter_t freqs[] {220., 440., 880.};
+  parameter_t bw[] {0., 5., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  const int features {
+    DetectorBank::runge_kutta | DetectorBank::search_normalized |
+    DetectorBank::amp_normalized
+  };
+
+  std::vector<inputSample_t> tone(len);
+  for (std::size_t i {0}; i < len; i++)
+    tone[i] = std::sin(2.*M_PI*440.*i/sr);
+
+  DetectorBank::setNormalisationCache("");
+  std::vector<discriminator_t> z[2];
+  DetectorBank deferred(sr, tone.data(), len, 1, freqs, bw, chans,
+                        static_cast<DetectorBank::Features>(
+                          features | DetectorBank::deferred_normalization), d);
+  std::atomic<std::size_t> reported {0};
+  deferred.setNormalisationCallback([&](std::size_t done, std::size_t total) {
+                                      if (total == chans) reported = done;
+                                    });
+  z[0].resize(chans*len);
+  if (deferred.getZ(z[0].data(), chans, len/2) != len/2)
+    return false;
+  deferred.waitForNormalisation();
+  if (!deferred.isNormalised() || deferred.getNormalisationProgress() != chans ||
+      reported != chans)
+    return false;
+  deferred.seek(0);
+  deferred.getZ(z[0].data(), chans, len);
+
+  DetectorBank db(sr, tone.data(), len, 1, freqs, bw, chans,
+                  static_cast<DetectorBank::Features>(features), d);
+  z[1].resize(chans*len);
+  db.getZ(z[1].data(), chans, len);
+
+  return z[0] == z[1];
+}
+
+// Feed a signal to a bank, some of whose channels are frequency shifted,
+// with process() in blocks of various lengths, some shorter than the
+// latency, then flush it. Return true if the output is identical to
+// that of getZ() given the whole signal.
+bool streamed_vs_buffered() {
+  const parameter_t sr {48000};
+  const std::size_t len {4800};
+  parameter_t freqs[] {440., 2000., 3500., 5000.};
+  parameter_t bw[] {0., 0., 0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  const DetectorBank::Features features {
+    static_cast<DetectorBank::Features>(
+      DetectorBank::runge_kutta | DetectorBank::freq_unnormalized |
+      DetectorBank::amp_normalized)
+  };
+
+  std::vector<inputSample_t> signal(len);
+  for (std::size_t i {0}; i < len; i++)
+    signal[i] = 0.5*std::sin(2.*M_PI*440.*i/sr) + 0.25*std::sin(2.*M_PI*3500.*i/sr) +
+                0.25*std::sin(2.*M_PI*5000.*i/sr);
+
+  DetectorBank buffered(sr, signal.data(), len, 1, freqs, bw, chans, features);
+  std::vector<discriminator_t> zb(chans*len);
+  buffered.getZ(zb.data(), chans, len);
+
+  DetectorBank streamed(sr, nullptr, 0, 1, freqs, bw, chans, features);
+  if (streamed.getLatency() == 0)
+    return false;
+  std::vector<discriminator_t> zs(chans*len), block;
+  std::size_t in {0}, out {0};
+  auto collect {
+    [&](const std::size_t done, const std::size_t stride) {
+      for (std::size_t c {0}; c < chans; c++)
+        std::copy(block.begin() + c*stride, block.begin() + c*stride + done,
+                  zs.begin() + c*len + out);
+      out += done;
+    }
+  };
+  const std::size_t blocks[] {1, 3, 2, 64, 5, 1000, 7, 256};
+  for (std::size_t b {0}; in < len; b++) {
+    const std::size_t n {std::min(blocks[b % 8], len - in)};
+    block.resize(chans*n);
+    collect(streamed.process(signal.data() + in, n, block.data()), n);
+    in += n;
+  }
+  block.resize(chans*streamed.getLatency());
+  collect(streamed.flush(block.data()), streamed.getLatency());
+
+  return out == len && zs == zb;
+}
+
+// Run a bank some of whose channels are frequency shifted, in two
+// calls to getZ() and again after seeking into the signal, both with
+// shifted copies of the input and with the input shifted on the fly.
+// Return true if the outputs are identical.
+bool on_the_fly_vs_copies() {
+  const parameter_t sr {48000};
+  const std::size_t len {4800};
+  const std::size_t half {len/2 + 11};
+  const std::size_t offset {1000};
+  parameter_t freqs[] {440., 2000., 3500., 5000., 5100.};
+  parameter_t bw[] {0., 0., 0., 0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  const int features {
+    DetectorBank::runge_kutta | DetectorBank::freq_unnormalized |
+    DetectorBank::amp_normalized
+  };
+
+  std::vector<inputSample_t> signal(len);
+  for (std::size_t i {0}; i < len; i++)
+    signal[i] = 0.5*std::sin(2.*M_PI*440.*i/sr) + 0.25*std::sin(2.*M_PI*3500.*i/sr) +
+                0.25*std::sin(2.*M_PI*5000.*i/sr);
+
+  auto run {
+    [&](const int f) {
+      DetectorBank db(sr, signal.data(), len, 1, freqs, bw, chans,
+                      static_cast<DetectorBank::Features>(f), 0.0001, 2.);
+      std::vector<discriminator_t> z(chans*(2*len - offset));
+      std::vector<discriminator_t> block(chans*len);
+      std::size_t out {0};
+      for (const std::size_t n : {half, len - half, len - offset}) {
+        if (n == len - offset)
+          db.seek(offset);
+        db.getZ(block.data(), chans, n);
+        for (std::size_t c {0}; c < chans; c++)
+          std::copy(block.begin() + c*n, block.begin() + (c+1)*n,
+                    z.begin() + c*(2*len - offset) + out);
+        out += n;
+      }
+      return z;
+    }
+  };
+
+  return run(features) == run(features | DetectorBank::shift_on_the_fly);
+}
+
+// Run a bank with and without the multirate feature on a mixture of
+// tones, the multirate bank in several calls to getZ() of lengths which
+// aren't multiples of the decimation factors. Return the largest
+// difference in |z| over the second half of the signal, relative to the
+// peak, or 1 if the multirate bank takes no fewer steps.
+double multirate_vs_full_rate(const int method) {
+  const parameter_t sr {48000};
+  const std::size_t len {48000};
+  parameter_t freqs[] {55., 110., 220., 440., 880., 1500., 3500.};
+  parameter_t bw[] {0., 0., 0., 0., 0., 0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  const int features {
+    method | DetectorBank::freq_unnormalized | DetectorBank::amp_normalized
+  };
+
+  std::vector<inputSample_t> signal(len);
+  for (std::size_t i {0}; i < len; i++)
+    signal[i] = 0.3*std::sin(2.*M_PI*110.*i/sr) + 0.3*std::sin(2.*M_PI*440.*i/sr) +
+                0.3*std::sin(2.*M_PI*3500.*i/sr) + 0.3*std::sin(2.*M_PI*9000.*i/sr);
+
+  DetectorBank full(sr, signal.data(), len, 1, freqs, bw, chans,
+                    static_cast<DetectorBank::Features>(features));
+  std::vector<discriminator_t> zf(chans*len);
+  full.getZ(zf.data(), chans, len);
+
+  DetectorBank multirate(sr, signal.data(), len, 1, freqs, bw, chans,
+                         static_cast<DetectorBank::Features>(
+                           features | DetectorBank::multirate));
+  if (multirate.getStepRate() >= chans*sr || multirate.getDecimation(0) < 2)
+    return 1;
+  std::vector<discriminator_t> zm(chans*len), block(chans*len);
+  for (std::size_t done {0}, n {0}; done < len; done += n) {
+    n = std::min(len - done, std::size_t(done ? 4999 : 3));
+    multirate.getZ(block.data(), chans, n);
+    for (std::size_t c {0}; c < chans; c++)
+      std::copy(block.begin() + c*n, block.begin() + (c+1)*n,
+                zm.begin() + c*len + done);
+  }
+
+  double peak {0}, diff {0};
+  for (std::size_t c {0}; c < chans; c++)
+    for (std::size_t n {len/2}; n < len; n++) {
+      peak = std::max(peak, std::abs(zf[c*len + n]));
+      diff = std::max(diff, std::abs(std::abs(zf[c*len + n]) - std::abs(zm[c*len + n])));
+    }
+  return diff / peak;
+}
+
+// Save a multirate bank as XML and load it into a bank made with other
+// channels reading the same signal. Return true if the loaded bank runs
+// its channels at the same rates, and its output matches the original's.
+bool multirate_profile() {
+  const parameter_t sr {48000};
+  const std::size_t len {9600};
+  parameter_t freqs[] {55., 110., 440., 3500.};
+  parameter_t bw[] {0., 0., 0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  parameter_t otherFreqs[] {1000.};
+  parameter_t otherBw[] {0.};
+
+  std::vector<inputSample_t> signal(len);
+  for (std::size_t i {0}; i < len; i++)
+    signal[i] = 0.5*std::sin(2.*M_PI*110.*i/sr) + 0.5*std::sin(2.*M_PI*3500.*i/sr);
+
+  DetectorBank original(sr, signal.data(), len, 1, freqs, bw, chans,
+                        static_cast<DetectorBank::Features>(
+                          DetectorBank::runge_kutta | DetectorBank::search_normalized |
+                          DetectorBank::amp_normalized | DetectorBank::multirate));
+  DetectorBank loaded(sr, signal.data(), len, 1, otherFreqs, otherBw, 1);
+  loaded.fromXML(original.toXML());
+  if (loaded.getChans() != chans || original.getDecimation(0) < 2)
+    return false;
+  for (std::size_t c {0}; c < chans; c++)
+    if (loaded.getDecimation(c) != original.getDecimation(c) ||
+        loaded.getW(c) != original.getW(c))
+      return false;
+
+  std::vector<discriminator_t> zo(chans*len), zl(chans*len);
+  original.getZ(zo.data(), chans, len);
+  loaded.getZ(zl.data(), chans, len);
+  double peak {0}, diff {0};
+  for (std::size_t i {0}; i < chans*len; i++) {
+    peak = std::max(peak, std::abs(zo[i]));
+    diff = std::max(diff, std::abs(zo[i] - zl[i]));
+  }
+  return diff < 1e-9*peak;
+}
+
+// Give a bank a signal sampled at 96kHz, as a buffer and in blocks to
+// process(). Return true if it runs at 48kHz, the output is the same
+// either way, and it matches that for the signal sampled at 48kHz to
+// within 0.1% of the peak.
+bool resampled_input() {
+  const parameter_t sr {48000};
+  const std::size_t len {4800};
+  parameter_t freqs[] {440., 2000., 3500., 5000.};
+  parameter_t bw[] {0., 0., 0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  auto tones {
+    [](const parameter_t rate, const std::size_t n) {
+      std::vector<inputSample_t> signal(n);
+      for (std::size_t i {0}; i < n; i++)
+        signal[i] = 0.5*std::sin(2.*M_PI*440.*i/rate) + 0.25*std::sin(2.*M_PI*3500.*i/rate) +
+                    0.25*std::sin(2.*M_PI*5000.*i/rate);
+      return signal;
+    }
+  };
+  const std::vector<inputSample_t> signal {tones(sr, len)};
+  const std::vector<inputSample_t> signal96k {tones(2*sr, 2*len)};
+
+  DetectorBank native(sr, signal.data(), len, 1, freqs, bw, chans);
+  std::vector<discriminator_t> zn(chans*len);
+  native.getZ(zn.data(), chans, len);
+
+  DetectorBank buffered(2*sr, signal96k.data(), 2*len, 1, freqs, bw, chans);
+  if (buffered.getSR() != sr || buffered.getInputSR() != 2*sr || buffered.getBuflen() != len)
+    return false;
+  std::vector<discriminator_t> zb(chans*len);
+  buffered.getZ(zb.data(), chans, len);
+
+  DetectorBank streamed(2*sr, nullptr, 0, 1, freqs, bw, chans);
+  std::vector<discriminator_t> zs(chans*len), block;
+  std::size_t in {0}, out {0};
+  auto collect {
+    [&](const std::size_t done, const std::size_t stride) {
+      for (std::size_t c {0}; c < chans; c++)
+        std::copy(block.begin() + c*stride, block.begin() + c*stride + done,
+                  zs.begin() + c*len + out);
+      out += done;
+    }
+  };
+  const std::size_t blocks {5};
+  for (std::size_t b {0}; in < 2*len; b++) {
+    const std::size_t n {std::min(2*len/blocks + b, 2*len - in)};
+    const std::size_t stride {streamed.getBlockFrames(n)};
+    block.resize(chans*stride);
+    collect(streamed.process(signal96k.data() + in, n, block.data()), stride);
+    in += n;
+  }
+  block.resize(chans*streamed.getLatency());
+  collect(streamed.flush(block.data()), streamed.getLatency());
+  if (out != len || zs != zb)
+    return false;
+
+  double peak {0}, diff {0};
+  for (std::size_t i {0}; i < chans*len; i++) {
+    peak = std::max(peak, std::abs(zn[i]));
+    diff = std::max(diff, std::abs(zn[i] - zb[i]));
+  }
+  return diff < 1e-3*peak;
+}
+
+// Write a tone as raw float32 samples and as a 16-bit stereo WAV file
+// with the tone in both channels, and check that banks reading the files
+// match banks given the same samples in a buffer. The banks are run in
+// blocks, and run again after seeking back to the start, so that pages
+// of the files are read again after they've been let go.
+bool mapped_file_input() {
+  const std::string raw {"c++tests-input.raw"}, wav {"c++tests-input.wav"};
+  const parameter_t sr {48000};
+  const std::size_t len {4800}, blockLen {1000};
+  parameter_t freqs[] {440., 2000.};
+  parameter_t bw[] {0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  std::vector<inputSample_t> tone(len), pcm(len);
+  std::vector<unsigned char> header, data;
+  auto le {
+    [](std::vector<unsigned char>& bytes, const std::uint32_t v, const int n) {
+      for (int b {0}; b < n; b++)
+        bytes.push_back(v >> 8*b & 0xff);
+    }
+  };
+  for (std::size_t i {0}; i < len; i++) {
+    tone[i] = 0.5*std::sin(2.*M_PI*440.*i/sr) + 0.25*std::sin(2.*M_PI*2000.*i/sr);
+    const std::int16_t s (std::lround(tone[i]*32767));
+    pcm[i] = s/32768.f;
+    le(data, std::uint16_t(s), 2);
+    le(data, std::uint16_t(s), 2);
+  }
+  for (const char* id : {"RIFF", "WAVE", "fmt "}) {
+    header.insert(header.end(), id, id+4);
+    if (id[0] == 'R')
+      le(header, 36 + data.size(), 4);
+  }
+  le(header, 16, 4);
+  le(header, 1, 2);          // PCM
+  le(header, 2, 2);          // channels
+  le(header, sr, 4);
+  le(header, sr*4, 4);       // bytes per second
+  le(header, 4, 2);          // bytes per frame
+  le(header, 16, 2);         // bits per sample
+  header.insert(header.end(), {'d', 'a', 't', 'a'});
+  le(header, data.size(), 4);
+
+  std::FILE* f {std::fopen(raw.c_str(), "wb")};
+  std::fwrite(tone.data(), sizeof(inputSample_t), len, f);
+  std::fclose(f);
+  f = std::fopen(wav.c_str(), "wb");
+  std::fwrite(header.data(), 1, header.size(), f);
+  std::fwrite(data.data(), 1, data.size(), f);
+  std::fclose(f);
+
+  auto run {
+    [&](DetectorBank& db) {
+      std::vector<discriminator_t> z(chans*len), block(chans*blockLen);
+      for (std::size_t done {0}, n {1}; n && done < len; done += n) {
+        n = db.getZ(block.data(), chans, blockLen);
+        for (std::size_t c {0}; c < chans; c++)
+          std::copy(block.begin() + c*blockLen, block.begin() + c*blockLen + n,
+                    z.begin() + c*len + done);
+      }
+      return z;
+    }
+  };
+
+  bool same {true};
+  {
+    DetectorBank buffered(sr, tone.data(), len, 1, freqs, bw, chans);
+    DetectorBank mapped(raw, 1, freqs, bw, chans, DetectorBank::Features::defaults,
+                        0.0001, 25., sr);
+    const std::vector<discriminator_t> z {run(mapped)};
+    mapped.seek(0);
+    same = same && mapped.getBuflen() == len && z == run(buffered) && z == run(mapped);
+  }
+  {
+    DetectorBank buffered(sr, pcm.data(), len, 1, freqs, bw, chans);
+    DetectorBank converted(wav, 1, freqs, bw, chans);
+    same = same && converted.getSR() == sr && converted.getBuflen() == len &&
+           run(converted) == run(buffered);
+  }
+  std::remove(raw.c_str());
+  std::remove(wav.c_str());
+  return same;
+}
+
+// Give banks the same tone as interleaved 16-bit stereo, 24-bit mono
+// and floating point stereo audio, and check that each matches a bank
+// given the tone as mono floating point samples.
+bool pcm_input() {
+  const parameter_t sr {48000};
+  const std::size_t len {4800};
+  parameter_t freqs[] {440., 2000.};
+  parameter_t bw[] {0., 0.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+
+  std::vector<inputSample_t> tone(len), stereo(2*len);
+  std::vector<std::int16_t> pcm16(2*len);
+  std::vector<std::int32_t> pcm24(len);
+  for (std::size_t i {0}; i < len; i++) {
+    const std::int16_t s (std::lround(32767*(0.5*std::sin(2.*M_PI*440.*i/sr) +
+                                             0.25*std::sin(2.*M_PI*2000.*i/sr))));
+    tone[i] = s/32768.f;
+    pcm16[2*i] = pcm16[2*i+1] = s;
+    pcm24[i] = s*256;
+    stereo[2*i] = stereo[2*i+1] = tone[i];
+  }
+
+  auto run {
+    [&](DetectorBank& db) {
+      std::vector<discriminator_t> z(chans*len);
+      db.getZ(z.data(), chans, len);
+      return z;
+    }
+  };
+
+  DetectorBank mono(sr, tone.data(), len, 1, freqs, bw, chans);
+  DetectorBank from16(sr, pcm16.data(), len, 2, 1, freqs, bw, chans);
+  DetectorBank from24(sr, pcm24.data(), len, 1, 24, 1, freqs, bw, chans);
+  DetectorBank fromStereo(sr, nullptr, 0, 1, freqs, bw, chans);
+  fromStereo.setInputBuffer(stereo.data(), len, 2);
+  const std::vector<discriminator_t> z {run(mono)};
+
+  return from16.getBuflen() == len && run(from16) == z &&
+         run(from24) == z && run(fromStereo) == z;
+}
+
+// Share jobs of very unequal cost between threads, one of which is held
+// up in its first job. Return true if every job is run exactly once.
+bool shared_jobs() {
+  ThreadPool pool(4);
+  const std::size_t jobs {50};
+  std::vector<std::atomic<int>> runs(jobs);
+  std::vector<double> costs(jobs);
+  std::vector<std::size_t> ids(jobs);
+  std::vector<void*> params(jobs);
+  for (std::size_t j {0}; j < jobs; j++) {
+    runs[j] = 0;
+    costs[j] = j < 10 ? 10 : 1;
+    ids[j] = j;
+    params[j] = &ids[j];
+  }
+
+  pool.share([&runs](void* p) {
+               const std::size_t j {*static_cast<std::size_t*>(p)};
+               if (j == 0)
+                 std::this_thread::sleep_for(std::chrono::milliseconds(20));
+               runs[j]++;
+             },
+             params.data(), jobs, costs.data());
+
+  return std::all_of(runs.begin(), runs.end(), [](const std::atomic<int>& r) {
+    return r == 1;
+  });
+}
+
+// Run banks of channels at several rates, some of them shifted, given in
+// no particular order, on one thread and on several, in blocks. Return
+// true if the output and the running maxima are the same either way.
+bool shared_vs_single_thread() {
+  const parameter_t sr {48000};
+  const std::size_t len {10000};
+  const std::size_t block {1000};
+  parameter_t freqs[] {4000., 60., 880., 5000., 110., 7040., 220., 3500.,
+                       440., 6000., 2000., 150., 1200., 5500., 300., 700.,
+                       8000., 90., 2500., 1760.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  std::vector<parameter_t> bw(chans, 0.);
+  const DetectorBank::Features features {
+    static_cast<DetectorBank::Features>(
+      DetectorBank::runge_kutta | DetectorBank::freq_unnormalized |
+      DetectorBank::amp_unnormalized | DetectorBank::multirate)
+  };
+
+  std::vector<inputSample_t> signal(len);
+  for (std::size_t i {0}; i < len; i++)
+    signal[i] = 0.3*std::sin(2.*M_PI*110.*i/sr) + 0.3*std::sin(2.*M_PI*880.*i/sr) +
+                0.3*std::sin(2.*M_PI*5000.*i/sr);
+
+  auto run {
+    [&](const std::size_t threads) {
+      DetectorBank db(sr, signal.data(), len, threads, freqs, bw.data(), chans,
+                      features);
+      std::vector<result_t> z(chans*len), out(chans*block), maxima(chans, 0.);
+      for (std::size_t done {0}; done < len; done += block) {
+        db.getAbsZ(out.data(), chans, block, 0, maxima.data());
+        for (std::size_t c {0}; c < chans; c++)
+          std::copy(out.begin() + c*block, out.begin() + (c+1)*block,
+                    z.begin() + c*len + done);
+      }
+      z.insert(z.end(), maxima.begin(), maxima.end());
+      return z;
+    }
+  };
+
+  return run(1) == run(4);
+}
+
+// Run a realtime bank in blocks of 128 frames beside a bank with the
+// default threads. Return true if their output is the same and the
+// realtime bank allocates nothing after its first block.
+bool realtime_blocks() {
+  const parameter_t sr {48000};
+  const std::size_t len {12800};
+  const std::size_t block {128};
+  parameter_t freqs[] {4000., 60., 880., 5000., 110., 7040., 220., 3500.,
+                       440., 6000., 2000., 150.};
+  const std::size_t chans {sizeof(freqs)/sizeof(freqs[0])};
+  std::vector<parameter_t> bw(chans, 0.);
+  const int features {
+    DetectorBank::runge_kutta | DetectorBank::freq_unnormalized |
+    DetectorBank::amp_unnormalized
+  };
+
+  std::vector<inputSample_t> signal(len);
+  for (std::size_t i {0}; i < len; i++)
+    signal[i] = 0.5*std::sin(2.*M_PI*440.*i/sr) + 0.5*std::sin(2.*M_PI*5000.*i/sr);
+
+  DetectorBank db(sr, signal.data(), len, 4, freqs, bw.data(), chans,
+                  static_cast<DetectorBank::Features>(features));
+  DetectorBank rt(sr, signal.data(), len, 4, freqs, bw.data(), chans,
+                  static_cast<DetectorBank::Features>(features | DetectorBank::realtime));
+  std::vector<discriminator_t> z(chans*block), zrt(chans*block);
+
+  bool same {true};
+  std::size_t allocated {0};
+  for (std::size_t done {0}; done < len; done += block) {
+    db.getZ(z.data(), chans, block);
+    const std::size_t before {allocations};
+    rt.getZ(zrt.data(), chans, block);
+    if (done)
+      allocated += allocations - before;
+    same = same && z == zrt;
+  }
+  return same && allocated == 0;
+}
+
 int main() {
-  plan(1);
+  plan(41);
 //   ok(true, "This test passes");
 //   is(foo(), 1, "foo() should be 1");
 //   is(bar(), "a string", "bar() should be \"a string\"");
+  // Keep normalisation results out of the user's cache
+  DetectorBank::setNormalisationCache("");
+
   ok(create(), "Allocate a detectorbank of 88 channels");
+  ok(batch_vs_scalar<CDDetector>(0) < 1e-9,
+     "Batched central difference solver matches scalar solver");
+  ok(batch_vs_scalar<RK4Detector>(0) < 1e-9,
+     "Batched Runge-Kutta solver matches scalar solver");
+  ok(batch_vs_scalar<RK4Detector>(5.) < 1e-9,
+     "Batched Runge-Kutta solver matches scalar solver (nonlinear)");
+  ok(batch_vs_scalar<ExactDetector>(0) < 1e-9,
+     "Batched exact linear solver matches scalar solver");
+  ok(batch_vs_scalar<SemiImplicitDetector>(0) < 1e-9,
+     "Batched semi-implicit solver matches scalar solver");
+  ok(batch_vs_scalar<SemiImplicitDetector>(5.) < 1e-9,
+     "Batched semi-implicit solver matches scalar solver (nonlinear)");
+  ok(exact_vs_rk4() < 1e-2,
+     "Exact linear solver agrees with Runge-Kutta at low frequencies");
+  ok(scan_vs_serial(DetectorBank::central_difference) < 1e-9,
+     "Scanned central difference bank matches serial bank");
+  ok(scan_vs_serial(DetectorBank::runge_kutta) < 1e-9,
+     "Scanned Runge-Kutta bank matches serial bank");
+  ok(scan_vs_serial(DetectorBank::exact_linear) < 1e-9,
+     "Scanned exact linear bank matches serial bank");
+  ok(scan_vs_serial(DetectorBank::semi_implicit) < 1e-9,
+     "Scanned semi-implicit bank matches serial bank");
+  ok(scan_allocations(),
+     "Banks scanning their channels don't allocate in getZ");
+  ok(single_vs_double(DetectorBank::central_difference) < 1e-3,
+     "Single-precision central difference bank tracks double precision");
+  ok(single_vs_double(DetectorBank::runge_kutta) < 1e-3,
+     "Single-precision Runge-Kutta bank tracks double precision");
+  ok(single_vs_double(DetectorBank::semi_implicit) < 1e-3,
+     "Single-precision semi-implicit bank tracks double precision");
+  ok(absz_vs_getz(DetectorBank::runge_kutta, 1) < 1e-9,
+     "getAbsZ matches getZ followed by absZ");
+  ok(absz_vs_getz(DetectorBank::exact_linear, 8) < 1e-9,
+     "Scanned getAbsZ matches getZ followed by absZ");
+  ok(pooled_vs_getz(DetectorBank::runge_kutta, 1) < 1e-6,
+     "Decimated and pooled output matches getZ");
+  ok(pooled_vs_getz(DetectorBank::exact_linear, 8) < 1e-6,
+     "Scanned decimated and pooled output matches getZ");
+  ok(cache_reuse(), "Normalisation results are reused from the cache file");
+  ok(parallel_construction(),
+     "Detectors normalised concurrently match those normalised serially");
+  ok(early_amplitude_normalize<RK4Detector>(0) < 1e-4,
+     "Early-terminating amplitude normalisation of minimum-bandwidth detectors");
+  ok(early_amplitude_normalize<RK4Detector>(5.) < 1e-4,
+     "Early-terminating amplitude normalisation of 5Hz bandwidth detectors");
+  ok(warm_search_normalize<RK4Detector>() < 1,
+     "Warm-started Runge-Kutta search normalisation matches full search");
+  ok(warm_search_normalize<CDDetector>() < 1,
+     "Warm-started central difference search normalisation matches full search");
+  ok(analytic_normalize<CDDetector>() < 1e-4,
+     "Analytic normalisation of central difference detectors matches simulation");
+  ok(analytic_normalize<RK4Detector>() < 1e-4,
+     "Analytic normalisation of linear Runge-Kutta detectors matches simulation");
+  ok(tabulated_normalize<RK4Detector>() < 1e-3,
+     "Tabulated normalisation of Runge-Kutta detectors matches simulation");
+  ok(tabulated_normalize<SemiImplicitDetector>() < 1e-3,
+     "Tabulated normalisation of semi-implicit detectors matches simulation");
+  ok(deferred_normalisation(),
+     "Deferred normalisation is applied between calls to getZ");
+  ok(streamed_vs_buffered(),
+     "Streamed input gives the same output as a buffer");
+  ok(on_the_fly_vs_copies(),
+     "Input shifted on the fly gives the same output as shifted copies");
+  ok(multirate_vs_full_rate(DetectorBank::runge_kutta) < 0.05,
+     "Multirate Runge-Kutta detectors match those run at the full rate");
+  ok(multirate_vs_full_rate(DetectorBank::exact_linear) < 0.05,
+     "Multirate exact detectors match those run at the full rate");
+  ok(multirate_profile(),
+     "Multirate banks saved and loaded run their channels at the same rates");
+  ok(resampled_input(),
+     "Input at 96kHz is resampled to 48kHz, as a buffer or a stream");
+  ok(mapped_file_input(),
+     "Banks reading raw and WAV files match banks reading buffers");
+  ok(pcm_input(),
+     "Interleaved integer and floating point input is converted to mono");
+  ok(shared_jobs(), "Jobs shared between threads are each run once");
+  ok(shared_vs_single_thread(),
+     "Banks sharing channels between threads match those run on one thread");
+  ok(realtime_blocks(),
+     "Realtime banks match others and don't allocate in getZ");
   return exit_status();
 }
@@ -0,0 +1,84 @@
+// Time getZ() for each of the small blocks in which live audio is
+// processed, for banks with and without the realtime feature, and
+// report the median, 99th and 99.9th percentile times per block.
+//
+// Usage: latencyBench [threads [seconds]]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include <detectorbank.h>
+
+int main(int argc, char* argv[]) {
+  const std::size_t threads {
+    argc > 1 ? std::strtoul(argv[1], nullptr, 10) : std::thread::hardware_concurrency()
+  };
+  const double seconds {argc > 2 ? std::atof(argv[2]) : 10.};
+  const parameter_t sr {48000};
+  const std::size_t len (seconds * sr);
+
+  // Every size of block is timed at least once
+  const std::size_t blocks[] {64, 128, 256};
+  const std::size_t longest {*std::max_element(std::begin(blocks), std::end(blocks))};
+  if (len < longest) {
+    std::fprintf(stderr, "At least %g s of input are needed\n", longest / sr);
+    return 1;
+  }
+
+  // An 88-note piano range, and two tones with a little noise
+  std::vector<parameter_t> freqs(88), bw(88, 0.);
+  for (std::size_t k {0}; k < freqs.size(); k++)
+    freqs[k] = 27.5 * std::pow(2., k/12.);
+  std::vector<inputSample_t> signal(len);
+  std::srand(1);
+  for (std::size_t i {0}; i < len; i++)
+    signal[i] = 0.4*std::sin(2.*M_PI*440.*i/sr) + 0.4*std::sin(2.*M_PI*3520.*i/sr) +
+                0.01*(std::rand() / double(RAND_MAX) - 0.5);
+
+  const int features {
+    DetectorBank::runge_kutta | DetectorBank::freq_unnormalized |
+    DetectorBank::amp_unnormalized
+  };
+
+  std::printf("%zu channels, %zu threads, %g s of input at %g Hz\n",
+              freqs.size(), threads, seconds, sr);
+  std::printf("%-9s %6s %10s %10s %10s  (us per block)\n",
+              "mode", "block", "p50", "p99", "p99.9");
+
+  for (const std::size_t block : blocks)
+    for (const bool realtime : {false, true}) {
+      DetectorBank db(sr, signal.data(), len, threads, freqs.data(), bw.data(),
+                      freqs.size(), static_cast<DetectorBank::Features>(
+                        realtime ? features | DetectorBank::realtime : features));
+      std::vector<discriminator_t> z(freqs.size() * block);
+      std::vector<double> times;
+      times.reserve(len / block);
+
+      for (std::size_t done {0}; done + block <= len; done += block) {
+        const auto start {std::chrono::steady_clock::now()};
+        db.getZ(z.data(), freqs.size(), block);
+        const std::chrono::duration<double, std::micro> time {
+          std::chrono::steady_clock::now() - start
+        };
+        times.push_back(time.count());
+      }
+
+      std::sort(times.begin(), times.end());
+      auto percentile {
+        [&times](const double p) {
+          return times[std::min(times.size() - 1, std::size_t(p * times.size()))];
+        }
+      };
+      std::printf("%-9s %6zu %10.1f %10.1f %10.1f\n",
+                  realtime ? "realtime" : "default", block,
+                  percentile(0.5), percentile(0.99), percentile(0.999));
+    }
+
+  return 0;
+}